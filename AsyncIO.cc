@@ -0,0 +1,441 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "Bruinbase.h"
+#include "AsyncIO.h"
+#include "IOStats.h"
+
+/**
+ * the I/O engine shared by all batches. it owns either an io_uring
+ * instance and a thread that reaps its completions, or a pool of
+ * threads that serve requests with pread/pwrite.
+ */
+class AsyncIO {
+ public:
+  static const int RING_ENTRIES = 256;  // # submission queue entries
+  static const int THREAD_COUNT = 8;    // # threads without io_uring
+
+  static AsyncIO& getEngine();
+
+  void submit(IORequest* reqs, int n);
+  bool usingIoUring() const { return ringFd >= 0; }
+
+ private:
+  AsyncIO();
+
+  // io_uring
+  int       ringFd;
+  unsigned  sqEntries, cqEntries;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  unsigned  inflight;               // # requests not yet reaped
+  std::mutex sqMutex;               // protects the submission queue
+  std::condition_variable sqSpace;  // signaled when requests are reaped
+
+  bool setupRing();
+  bool probeRing();
+  void reap();
+
+  // thread pool
+  std::deque<IORequest*> queue;
+  std::mutex queueMutex;
+  std::condition_variable queueReady;
+
+  void serve(int n);
+
+  static void execute(IORequest& req, size_t done = 0);
+};
+
+AsyncIO& AsyncIO::getEngine()
+{
+  // created on first use. it is never destroyed, as its threads keep
+  // running until the process exits.
+  static AsyncIO* engine = new AsyncIO;
+  return *engine;
+}
+
+AsyncIO::AsyncIO()
+{
+  inflight = 0;
+  if (setupRing()) {
+    std::thread(&AsyncIO::reap, this).detach();
+  } else {
+    ringFd = -1;
+    for (int i = 0; i < THREAD_COUNT; i++) std::thread(&AsyncIO::serve, this, i + 1).detach();
+  }
+}
+
+bool AsyncIO::setupRing()
+{
+  struct io_uring_params p;
+  size_t sqSize, cqSize;
+  char  *sq, *cq;
+
+  memset(&p, 0, sizeof(p));
+  ringFd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+  if (ringFd < 0) return false;
+  if (!probeRing()) goto fail;
+
+  // map the submission and completion rings and the sqe array
+  sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (cqSize > sqSize) sqSize = cqSize;
+    cqSize = sqSize;
+  }
+  sq = (char*)mmap(NULL, sqSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) goto fail;
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    cq = sq;
+  } else {
+    cq = (char*)mmap(NULL, cqSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) goto fail;
+  }
+  sqes = (struct io_uring_sqe*)mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                                    PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) goto fail;
+
+  sqEntries = p.sq_entries;
+  sqHead  = (unsigned*)(sq + p.sq_off.head);
+  sqTail  = (unsigned*)(sq + p.sq_off.tail);
+  sqMask  = (unsigned*)(sq + p.sq_off.ring_mask);
+  sqArray = (unsigned*)(sq + p.sq_off.array);
+  cqEntries = p.cq_entries;
+  cqHead  = (unsigned*)(cq + p.cq_off.head);
+  cqTail  = (unsigned*)(cq + p.cq_off.tail);
+  cqMask  = (unsigned*)(cq + p.cq_off.ring_mask);
+  cqes    = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+  return true;
+
+ fail:
+  ::close(ringFd);
+  ringFd = -1;
+  return false;
+}
+
+bool AsyncIO::probeRing()
+{
+  static const int ops[] = { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READV, IORING_OP_WRITEV };
+  std::vector<char> buf(sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+  struct io_uring_probe* probe = (struct io_uring_probe*)&buf[0];
+
+  // a ring may exist without the operations used by submit() (e.g.,
+  // IORING_OP_READ came in Linux 5.6, as did the probe itself)
+  if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) return false;
+  for (unsigned i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) return false;
+  }
+  return true;
+}
+
+void AsyncIO::execute(IORequest& req, size_t done)
+{
+  std::vector<struct iovec> iov(req.iov);
+  unsigned k = 0;
+  ssize_t n;
+
+  // transfer the rest of the range from done, retrying on short transfers
+  for (;;) {
+    // skip the buffers (or the part of the buffer) already transferred
+    size_t skip = done;
+    if (!iov.empty()) {
+      for (k = 0; k < iov.size() && skip >= iov[k].iov_len; k++) skip -= iov[k].iov_len;
+      if (k < iov.size()) {
+        iov[k].iov_base = (char*)req.iov[k].iov_base + skip;
+        iov[k].iov_len = req.iov[k].iov_len - skip;
+      }
+    }
+    if (done >= req.len) break;
+
+    if (iov.empty()) {
+      if (req.write) n = ::pwrite(req.fd, req.buf + done, req.len - done, req.offset + done);
+      else n = ::pread(req.fd, req.buf + done, req.len - done, req.offset + done);
+    } else {
+      if (req.write) n = ::pwritev(req.fd, &iov[k], iov.size() - k, req.offset + done);
+      else n = ::preadv(req.fd, &iov[k], iov.size() - k, req.offset + done);
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) { req.result = -errno; return; }
+    if (n == 0) break;
+    done += n;
+  }
+  req.result = done;
+}
+
+void AsyncIO::submit(IORequest* reqs, int n)
+{
+  if (ringFd < 0) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    for (int i = 0; i < n; i++) queue.push_back(&reqs[i]);
+    queueReady.notify_all();
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(sqMutex);
+  int i = 0;
+  while (i < n) {
+    unsigned tail = *sqTail, queued = 0;
+
+    // keep the completion queue from overflowing
+    while (inflight >= cqEntries) sqSpace.wait(lock);
+
+    // fill as many submission queue entries as there is room for
+    while (i < n && tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) < sqEntries &&
+           inflight < cqEntries) {
+      IORequest& req = reqs[i++];
+      unsigned idx = tail & *sqMask;
+      struct io_uring_sqe* sqe = &sqes[idx];
+
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->fd = req.fd;
+      if (req.iov.empty()) {
+        sqe->opcode = req.write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->addr = (unsigned long)req.buf;
+        sqe->len = req.len;
+      } else {
+        sqe->opcode = req.write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->addr = (unsigned long)&req.iov[0];
+        sqe->len = req.iov.size();
+      }
+      sqe->off = req.offset;
+      sqe->user_data = (unsigned long)&req;
+      sqArray[idx] = idx;
+      tail++;
+      queued++;
+      inflight++;
+    }
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+    // tell the kernel about the new entries
+    while (queued > 0) {
+      int r = (int)syscall(__NR_io_uring_enter, ringFd, queued, 0, 0, NULL, 0);
+      if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        // the kernel did not take the last entries, and never will: take
+        // them back, and serve them and the rest of the requests here
+        int first = i - (int)queued;
+        __atomic_store_n(sqTail, tail - queued, __ATOMIC_RELEASE);
+        inflight -= queued;
+        sqSpace.notify_all();
+        lock.unlock();
+        for (i = first; i < n; i++) {
+          execute(reqs[i]);
+          reqs[i].batch->complete(reqs[i]);
+        }
+        return;
+      }
+      if (r > 0) queued -= r;
+    }
+  }
+}
+
+void AsyncIO::reap()
+{
+  IOStats::nameThread("io_uring reaper");
+  for (;;) {
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+      // wait for at least one completion
+      syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+      continue;
+    }
+
+    for (; head != tail; head++) {
+      struct io_uring_cqe* cqe = &cqes[head & *cqMask];
+      IORequest& req = *(IORequest*)(unsigned long)cqe->user_data;
+
+      // the request was queued under sqMutex; taking it orders our
+      // accesses after the submitter's (the kernel is invisible to
+      // race detectors)
+      { std::unique_lock<std::mutex> lock(sqMutex); }
+
+      // finish a short transfer synchronously
+      if (cqe->res >= 0 && (size_t)cqe->res < req.len) {
+        execute(req, cqe->res);
+      } else {
+        req.result = cqe->res;
+      }
+      __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+      {
+        std::unique_lock<std::mutex> lock(sqMutex);
+        inflight--;
+        sqSpace.notify_all();
+      }
+      req.batch->complete(req);
+    }
+  }
+}
+
+void AsyncIO::serve(int n)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "I/O thread %d", n);
+  IOStats::nameThread(name);
+
+  for (;;) {
+    IORequest* req;
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      while (queue.empty()) queueReady.wait(lock);
+      req = queue.front();
+      queue.pop_front();
+    }
+    execute(*req);
+    req->batch->complete(*req);
+  }
+}
+
+
+IOBatch::IOBatch()
+{
+  pending = 0;
+  submitted = false;
+  detached = false;
+}
+
+IOBatch::~IOBatch()
+{
+  if (!detached) wait();
+}
+
+void IOBatch::add(int fd, char* buf, size_t len, off_t offset, bool write,
+                  void (*callback)(IORequest&), const void* arg, long long tag)
+{
+  IORequest req;
+
+  if (submitted) return;
+
+  req.fd = fd;
+  req.buf = buf;
+  req.len = len;
+  req.offset = offset;
+  req.write = write;
+  req.result = 0;
+  req.submitTime = 0;
+  req.latency = 0;
+  req.callback = callback;
+  req.arg = arg;
+  req.tag = tag;
+  req.batch = this;
+  requests.push_back(req);
+}
+
+void IOBatch::addRead(int fd, void* buf, size_t len, off_t offset,
+                      void (*callback)(IORequest&), const void* arg, long long tag)
+{
+  add(fd, (char*)buf, len, offset, false, callback, arg, tag);
+}
+
+void IOBatch::addVector(int fd, const struct iovec* iov, int iovcnt, off_t offset, bool write,
+                        void (*callback)(IORequest&), const void* arg, long long tag)
+{
+  size_t len = 0;
+
+  if (submitted || iovcnt <= 0) return;
+  for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+
+  add(fd, (char*)iov[0].iov_base, len, offset, write, callback, arg, tag);
+  requests.back().iov.assign(iov, iov + iovcnt);
+}
+
+void IOBatch::addReadv(int fd, const struct iovec* iov, int iovcnt, off_t offset,
+                       void (*callback)(IORequest&), const void* arg, long long tag)
+{
+  addVector(fd, iov, iovcnt, offset, false, callback, arg, tag);
+}
+
+void IOBatch::addWrite(int fd, const void* buf, size_t len, off_t offset,
+                       void (*callback)(IORequest&), const void* arg, long long tag)
+{
+  add(fd, (char*)buf, len, offset, true, callback, arg, tag);
+}
+
+void IOBatch::addWritev(int fd, const struct iovec* iov, int iovcnt, off_t offset,
+                        void (*callback)(IORequest&), const void* arg, long long tag)
+{
+  addVector(fd, iov, iovcnt, offset, true, callback, arg, tag);
+}
+
+RC IOBatch::submit()
+{
+  if (submitted) return 0;
+  submitted = true;
+  if (requests.empty()) return 0;
+
+  pending = (int)requests.size();
+  long long now = IOStats::now();
+  for (unsigned i = 0; i < requests.size(); i++) requests[i].submitTime = now;
+  AsyncIO::getEngine().submit(&requests[0], pending);
+  return 0;
+}
+
+RC IOBatch::wait()
+{
+  RC rc = 0;
+
+  if (!submitted) return 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (pending > 0) done.wait(lock);
+  }
+
+  for (unsigned i = 0; i < requests.size(); i++) {
+    if (requests[i].result != (ssize_t)requests[i].len) {
+      rc = requests[i].write ? RC_FILE_WRITE_FAILED : RC_FILE_READ_FAILED;
+    }
+  }
+  return rc;
+}
+
+void IOBatch::detach()
+{
+  submit();
+
+  // whoever sees the batch complete last deletes it
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pending > 0) {
+      detached = true;
+      return;
+    }
+  }
+  delete this;
+}
+
+void IOBatch::complete(IORequest& req)
+{
+  req.latency = IOStats::now() - req.submitTime;
+  if (req.callback != NULL) req.callback(req);
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (--pending > 0) return;
+    if (!detached) {
+      done.notify_all();
+      return;
+    }
+  }
+  delete this;
+}
+
+bool IOBatch::usingIoUring()
+{
+  return AsyncIO::getEngine().usingIoUring();
+}
@@ -0,0 +1,160 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "Bruinbase.h"
+
+class IOBatch;
+
+/**
+ * a single asynchronous read or write.
+ */
+struct IORequest {
+  int     fd;       // the file to read from or write to
+  char*   buf;      // the memory buffer
+  size_t  len;      // # bytes to transfer
+  std::vector<struct iovec> iov; // the buffers of a vectored request.
+                    // empty unless the request was added by addReadv()
+                    // or addWritev()
+  off_t   offset;   // the file offset
+  bool    write;    // true for a write, false for a read
+  ssize_t result;   // # bytes transferred, or -errno. set on completion
+  long long submitTime; // when the request was submitted (IOStats::now())
+  long long latency;    // nanoseconds from the submission to the
+                        //   completion. set on completion
+
+  // called on an I/O thread when the request completes (may be NULL)
+  void  (*callback)(IORequest& req);
+  const void* arg;  // argument for the callback
+  long long   tag;  // argument for the callback
+
+  IOBatch* batch;   // the batch the request belongs to
+};
+
+/**
+ * a batch of reads and writes that are submitted together and completed
+ * asynchronously, so that many I/Os are in flight at the same time.
+ * requests are served by Linux io_uring when the kernel supports it (with
+ * the read and write operations), and by a pool of I/O threads doing
+ * pread/pwrite otherwise.
+ * usage: add requests, submit(), do other work, then wait().
+ * a batch that nobody waits for can be handed over with detach().
+ */
+class IOBatch {
+ public:
+  IOBatch();
+
+  /**
+   * wait for any outstanding request before the batch goes away.
+   */
+  ~IOBatch();
+
+  /**
+   * add a read request to the batch. requests cannot be added
+   * once the batch is submitted.
+   * @param fd[IN] the file to read from
+   * @param buf[IN] the buffer to read into
+   * @param len[IN] # bytes to read
+   * @param offset[IN] the file offset to read from
+   * @param callback[IN] called on an I/O thread when the read completes
+   * @param arg[IN] passed to the callback in IORequest::arg
+   * @param tag[IN] passed to the callback in IORequest::tag
+   */
+  void addRead(int fd, void* buf, size_t len, off_t offset,
+               void (*callback)(IORequest&) = NULL, const void* arg = NULL, long long tag = 0);
+
+  /**
+   * add a vectored read request to the batch: a contiguous range of the
+   * file is read into several buffers with a single I/O.
+   * @param fd[IN] the file to read from
+   * @param iov[IN] the buffers to read into, in the order of the file
+   * @param iovcnt[IN] # buffers in iov
+   * @param offset[IN] the file offset to read from
+   * @param callback[IN] called on an I/O thread when the read completes
+   * @param arg[IN] passed to the callback in IORequest::arg
+   * @param tag[IN] passed to the callback in IORequest::tag
+   */
+  void addReadv(int fd, const struct iovec* iov, int iovcnt, off_t offset,
+                void (*callback)(IORequest&) = NULL, const void* arg = NULL, long long tag = 0);
+
+  /**
+   * add a write request to the batch. see addRead() for the parameters.
+   */
+  void addWrite(int fd, const void* buf, size_t len, off_t offset,
+                void (*callback)(IORequest&) = NULL, const void* arg = NULL, long long tag = 0);
+
+  /**
+   * add a vectored write request to the batch: several buffers are
+   * written to a contiguous range of the file with a single I/O.
+   * see addReadv() for the parameters.
+   */
+  void addWritev(int fd, const struct iovec* iov, int iovcnt, off_t offset,
+                 void (*callback)(IORequest&) = NULL, const void* arg = NULL, long long tag = 0);
+
+  /**
+   * hand all requests of the batch to the I/O engine.
+   * @return error code. 0 if no error
+   */
+  RC submit();
+
+  /**
+   * wait until every submitted request has completed.
+   * @return error code. 0 if every request transferred all its bytes
+   */
+  RC wait();
+
+  /**
+   * submit the batch (if not yet submitted) and give up the ownership
+   * of it: the batch deletes itself when its last request completes.
+   * the batch must have been created with new.
+   */
+  void detach();
+
+  /**
+   * @return # requests in the batch
+   */
+  int size() const { return (int)requests.size(); }
+
+  /**
+   * @param i[IN] the request number
+   * @return the request
+   */
+  const IORequest& getRequest(int i) const { return requests[i]; }
+
+  /**
+   * @return true if requests are served by io_uring, false if by threads
+   */
+  static bool usingIoUring();
+
+ private:
+  std::vector<IORequest> requests;
+  int  pending;    // # submitted requests that have not completed
+  bool submitted;  // true once submit() is called
+  bool detached;   // true if the batch deletes itself
+  std::mutex mutex;
+  std::condition_variable done;
+
+  IOBatch(const IOBatch&);
+  IOBatch& operator=(const IOBatch&);
+
+  void add(int fd, char* buf, size_t len, off_t offset, bool write,
+           void (*callback)(IORequest&), const void* arg, long long tag);
+  void addVector(int fd, const struct iovec* iov, int iovcnt, off_t offset, bool write,
+                 void (*callback)(IORequest&), const void* arg, long long tag);
+
+  friend class AsyncIO;
+  void complete(IORequest& req);
+};
+
+#endif // ASYNCIO_H
@@ -9,9 +9,25 @@
  
 #include "BTreeIndex.h"
 #include "BTreeNode.h"
+#include "BufferPool.h"
+#include "Checksum.h"
+#include <algorithm>
+#include <stdint.h>
 
 using namespace std;
 
+std::atomic<int> BTreeIndex::pinBudget(BTreeIndex::DEFAULT_PIN_BUDGET);
+std::atomic<int> BTreeIndex::pinnedBytes(0);
+
+//the header pages of a shadow-paged index carry this after the metadata
+struct ShadowHeader {
+	uint32_t magic;      //SHADOW_MAGIC
+	uint32_t crc;        //CRC32C of the page up to the end of this, with crc 0
+	int64_t  generation; //the commit that wrote the page
+};
+static const uint32_t SHADOW_MAGIC = 0x57444853; //"SHDW" on little-endian
+static const int SHADOW_OFFSET = 16;             //after rootPid, treeHeight, branchingFactor
+
 /*
  * BTreeIndex constructor
  */
@@ -19,6 +35,9 @@ BTreeIndex::BTreeIndex()
 {
     rootPid = -1;
     treeHeight = 0;
+    opened = false;
+    shadow = false;
+    generation = 0;
 }
 
 BTreeIndex::~BTreeIndex()
@@ -29,9 +48,9 @@ BTreeIndex::~BTreeIndex()
 }
 
 int BTreeIndex::endeidofLastpage(){
-    BTLeafNode *node = new BTLeafNode();
-    node->read(pf.endPid()-1, pf);
-    return node->getendEid();
+    BTLeafNode node;
+    node.read(pf.endPid()-1, pf);
+    return node.getendEid();
 }
 
 PageId BTreeIndex::endPageNum()
@@ -49,47 +68,86 @@ PageId BTreeIndex::endPageNum()
  */
 RC BTreeIndex::readpagefilenode(PageId pid)
 {
-    BTLeafNode* node = new BTLeafNode();
-    node->read(pid, pf);
-    node->printNodeContent();
+    BTLeafNode node;
+    node.read(pid, pf);
+    node.printNodeContent();
     return 0;
 }
 RC BTreeIndex::readpagefilenonleafnode(PageId pid)
 {
-    BTNonLeafNode* node = new BTNonLeafNode();
-    node->read(pid, pf);
-    node->printNodeContent();
+    BTNonLeafNode node;
+    node.read(pid, pf);
+    node.printNodeContent();
     return 0;
 }
 
-RC BTreeIndex::open(const string& indexname, char mode)
+RC BTreeIndex::open(const string& indexname, char mode, int flags)
 {
     RC rc;
 	
-	if ((rc = pf.open(indexname, mode)) < 0) return rc;
+	if ((rc = pf.open(indexname, mode, flags & ~SHADOW)) < 0) return rc;
 	
 	opened = true;
+	shadow = false;
+	generation = 0;
 	if(pf.endPid() > 0){
 		//if the index file is not empty.
 		
 		//metadata including rootPid, treeHeight & branchingFactor are stored sequentially in the first page of a index file
-		char metadata[PageFile::PAGE_SIZE];
+		char metadata[PageFile::MAX_PAGE_SIZE];
+		char other[PageFile::MAX_PAGE_SIZE];
+		long long otherGeneration;
 		
-		if ((rc = pf.read(0, metadata)) < 0) {
-		// an error occurred during page read
+		//a shadow-paged index has two header pages; the newer valid one counts
+		int valid0 = readHeader(0, metadata, generation);
+		int valid1 = (valid0 != 0 && pf.endPid() > 1) ? readHeader(1, other, otherGeneration) : 0;
+		shadow = valid0 > 0 || valid1 > 0;
+		if(valid1 > 0 && (valid0 <= 0 || otherGeneration > generation)){
+			memcpy(metadata, other, pf.getPageSize());
+			generation = otherGeneration;
+		}
+		
+		if (!shadow && valid0 < 0) {
+		// an error occurred during page read, or both header pages are corrupt
+		if ((rc = pf.read(0, metadata)) >= 0) rc = RC_INVALID_FILE_FORMAT;
 		pf.close();
 		return rc;
 		}
 		
-		memcpy(&rootPid, metadata, sizeof(PageId));
-		memcpy(&treeHeight, metadata + sizeof(PageId), sizeof(int));
-		memcpy(&branchingFactor, metadata + sizeof(PageId) + sizeof(int), sizeof(int));
+		//rootPid takes pf.getPidSize() bytes
+		rootPid = pf.loadPid(metadata);
+		memcpy(&treeHeight, metadata + pf.getPidSize(), sizeof(int));
+		memcpy(&branchingFactor, metadata + pf.getPidSize() + sizeof(int), sizeof(int));
+		savedRootPid = rootPid;
+		savedHeight = treeHeight;
 	}
 	else{
 		//if the index file is empty
-		branchingFactor = BRANCHING_FACTOR;
+		//the nodes of larger pages hold proportionally more entries,
+		//but wider page ids leave room for fewer
+		branchingFactor = BRANCHING_FACTOR * pf.getPageSize() / PageFile::PAGE_SIZE;
+		branchingFactor = min(branchingFactor, BTLeafNode::capacity(pf.getPageSize(), pf.getPidSize()));
+		branchingFactor = min(branchingFactor, BTNonLeafNode::capacity(pf.getPageSize(), pf.getPidSize()));
+		savedRootPid = -1;
+		savedHeight = -1;
+		
+		//a new shadow-paged index starts with both header pages
+		if(mode == 'w' && (flags & SHADOW)){
+			shadow = true;
+			if((rc = writeMetadata()) >= 0){
+				generation = 1;
+				rc = writeMetadata();
+			}
+			if(rc < 0){
+				pf.close();
+				return rc;
+			}
+		}
 	}
 	
+	//the background writer of the buffer pool saves the metadata from time to time
+	if(mode == 'w')
+		BufferPool::addCheckpoint(checkpointed, this);
 	
 	return rc;
 }
@@ -102,12 +160,24 @@ RC BTreeIndex::close()
 {
     RC rc;
 	
-	char metadata[PageFile::PAGE_SIZE];
-	memcpy(metadata, &rootPid, sizeof(PageId));
-	memcpy(metadata + sizeof(PageId), &treeHeight, sizeof(int));
-	memcpy(metadata + sizeof(PageId) + sizeof(int), &branchingFactor, sizeof(int));
+	BufferPool::removeCheckpoint(this);
+	unpinNodes();
+	
+	rc = 0;
+	if(shadow){
+		//the pages replaced since the index was opened become free only now,
+		//so that the readers opened meanwhile keep their snapshot
+		if((rc = publish()) >= 0){
+			for(vector<PageId>::iterator it = retiredPages.begin(); it != retiredPages.end(); it++)
+				pf.freePage(*it);
+		}
+		retiredPages.clear();
+		freshPages.clear();
+	}
+	else if(rootPid != savedRootPid || treeHeight != savedHeight)
+		rc = writeMetadata();
 	
-	if ((rc = pf.write(0, metadata)) < 0) {
+	if (rc < 0) {
 		// an error occurred during page write
 		rootPid = -1;
 		treeHeight = 0;
@@ -131,6 +201,113 @@ RC BTreeIndex::close()
  * @param rid[IN] the RecordId for the record being inserted into the index
  * @return error code. 0 if no error
  */
+/*
+ * Write the metadata of the index to its first page.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::writeMetadata()
+{
+    RC rc;
+	
+	char metadata[PageFile::MAX_PAGE_SIZE];
+	memset(metadata, 0, pf.getPageSize());
+	pf.storePid(metadata, rootPid);
+	memcpy(metadata + pf.getPidSize(), &treeHeight, sizeof(int));
+	memcpy(metadata + pf.getPidSize() + sizeof(int), &branchingFactor, sizeof(int));
+	
+	//a shadow-paged index writes its two header pages in turn
+	if (shadow) {
+		ShadowHeader header;
+		header.magic = SHADOW_MAGIC;
+		header.crc = 0;
+		header.generation = generation;
+		memcpy(metadata + SHADOW_OFFSET, &header, sizeof(header));
+		header.crc = crc32c(metadata, SHADOW_OFFSET + sizeof(header));
+		memcpy(metadata + SHADOW_OFFSET, &header, sizeof(header));
+	}
+	
+	if ((rc = pf.write(shadow ? generation % 2 : 0, metadata)) < 0) return rc;
+	
+	savedRootPid = rootPid;
+	savedHeight = treeHeight;
+	return 0;
+}
+
+/*
+ * Read a header page of a shadow-paged index.
+ * @param pid[IN] the header page (0 or 1)
+ * @param page[OUT] the content of the page
+ * @param gen[OUT] the commit that wrote the page
+ * @return 1 if the page is a valid header page, 0 if it is not marked as
+ *         one, -1 if it cannot be read or its header is corrupt
+ */
+int BTreeIndex::readHeader(PageId pid, char* page, long long& gen)
+{
+	ShadowHeader header;
+	
+	if(pf.read(pid, page) < 0)
+		return -1;
+	memcpy(&header, page + SHADOW_OFFSET, sizeof(header));
+	if(header.magic != SHADOW_MAGIC)
+		return 0;
+	
+	uint32_t crc = header.crc;
+	header.crc = 0;
+	memcpy(page + SHADOW_OFFSET, &header, sizeof(header));
+	gen = header.generation;
+	return (crc32c(page, SHADOW_OFFSET + sizeof(header)) == crc) ? 1 : -1;
+}
+
+RC BTreeIndex::commit()
+{
+	lock_guard<mutex> guard(metaLatch);
+	return publish();
+}
+
+RC BTreeIndex::publish()
+{
+    RC rc;
+	
+	if(!shadow || (freshPages.empty() && rootPid == savedRootPid && treeHeight == savedHeight))
+		return 0;
+	
+	//the new nodes must be on the disk before the header that points to them
+	if((rc = pf.sync()) < 0)
+		return rc;
+	
+	//a failed header is written again to the same page, which leaves
+	//the header of the last commit intact
+	generation++;
+	if((rc = writeMetadata()) < 0 || (rc = pf.sync()) < 0){
+		generation--;
+		return rc;
+	}
+	freshPages.clear();
+	return 0;
+}
+
+RC BTreeIndex::checkpoint()
+{
+    RC rc;
+	
+	if(shadow)
+		return commit();
+	
+	//insert() changes the pinned nodes in place, so they are written
+	//while it is held off. the nodes must reach the disk before the
+	//metadata that points to them.
+	lock_guard<mutex> guard(metaLatch);
+	if ((rc = pf.flush()) < 0) return rc;
+	if (rootPid == savedRootPid && treeHeight == savedHeight) return 0;
+	if ((rc = writeMetadata()) < 0) return rc;
+	return pf.flush();
+}
+
+void BTreeIndex::checkpointed(void* index)
+{
+	((BTreeIndex*)index)->checkpoint();
+}
+
 RC BTreeIndex::insert(int key, const RecordId& rid)
 {
     RC rc;
@@ -138,21 +315,42 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
 	int currentHeight = 1;
 	int returnedKey;
 	PageId returnedPid;
-	bool splited;
-	traverseInsert(key, rid, nodeId, currentHeight, returnedKey, returnedPid, splited);
+	bool splited = false;
+	lock_guard<mutex> guard(metaLatch);
+	//an index of an old format cannot point to pages past its page ids
+	if(rid.pid > pf.maxPid())
+		return RC_INVALID_RID;
+	size_t retired = retiredPages.size();
+	insertPages.clear();
+	if((rc = traverseInsert(key, rid, nodeId, currentHeight, returnedKey, returnedPid, splited)) < 0)
+		return abortInsert(retired, rc);
 	
 	if(splited){
 		//new root
-		BTNonLeafNode* newRoot = new BTNonLeafNode;
-		newRoot->initializeRoot(rootPid, returnedKey, returnedPid);
+		BTNonLeafNode newRoot;
+		PageId newRootPid;
+		if((rc = allocateNode(newRootPid, nodeId)) < 0){
+			return abortInsert(retired, rc);
+		}
+		if((rc = newRoot.create(newRootPid, pf)) < 0){
+			return abortInsert(retired, rc);
+		}
+		newRoot.initializeRoot(nodeId, returnedKey, returnedPid);
 		
-		if((rc = newRoot->write(pf.endPid(), pf)) < 0){
+		if((rc = newRoot.write(newRootPid, pf)) < 0){
             fprintf(stderr, "Error, cannot write newRoot to Pagefile");
-			return rc;
+			return abortInsert(retired, rc);
 		}
-		rootPid = pf.endPid() - 1;
+		nodeId = newRootPid;
 		treeHeight++;
+		pinNode(newRootPid);
 	}
+	//the root moves when it is copied
+	rootPid = nodeId;
+	
+	//a logged index logs its metadata along with the nodes it points to
+	if(!shadow && (pf.getFlags() & PageFile::LOGGED) && (rootPid != savedRootPid || treeHeight != savedHeight))
+		return writeMetadata();
 	
 	return 0;
 }
@@ -202,21 +400,31 @@ RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
 RC BTreeIndex::readForward(IndexCursor& cursor, int& key, RecordId& rid)
 {
     RC rc;
-	BTLeafNode* leaf = new BTLeafNode;
-	if((rc = leaf->read(cursor.pid, pf)) < 0){
+	BTLeafNode leaf;
+	if((rc = leaf.read(cursor.pid, pf)) < 0){
         //fprintf(stderr, "ERROR1");
 		return rc;
 	}
     
-    if((rc = leaf->readEntry(cursor.eid, key, rid)) < 0){
+    if((rc = leaf.readEntry(cursor.eid, key, rid)) < 0){
         //fprintf(stderr, "ERROR2");
         return rc;
     }
 	
-	if(cursor.eid >= leaf->getKeyCount() - 1)
+	if(cursor.eid >= leaf.getKeyCount() - 1)
 	{
 		//at the last entry of this node
-		cursor.pid = leaf->getNextNodePtr();
+		if(shadow){
+			//the first key of the node leads to it through the tree
+			int firstKey;
+			RecordId firstRid;
+			leaf.readEntry(0, firstKey, firstRid);
+			if((rc = nextLeaf(firstKey, cursor.pid)) < 0){
+				return rc;
+			}
+		}
+		else
+			cursor.pid = leaf.getNextNodePtr();
 		cursor.eid = 0;
 	}
 	else{
@@ -226,22 +434,30 @@ RC BTreeIndex::readForward(IndexCursor& cursor, int& key, RecordId& rid)
 	return 0;
 }
 
-RC BTreeIndex::traverseInsert(int key, const RecordId& rid, PageId nodeId, int cHeight, int& returnedKey, PageId& returnedPid, bool& splited)
+RC BTreeIndex::traverseInsert(int key, const RecordId& rid, PageId& nodeId, int cHeight, int& returnedKey, PageId& returnedPid, bool& splited)
 {
 	RC rc;
 	
 	if(rootPid == -1){
 		//new B+ tree
-		BTLeafNode* leaf = new BTLeafNode;
-		if((rc = leaf->insert(key, rid)) < 0){
+		BTLeafNode leaf;
+		//the first leaf of a shadow-paged index follows the header pages
+		nodeId = 1;
+		if(shadow && (rc = allocateNode(nodeId, -1)) < 0){
+			return rc;
+		}
+		if((rc = leaf.create(nodeId, pf)) < 0){
+			return rc;
+		}
+		if((rc = leaf.insert(key, rid)) < 0){
             //fprintf(stderr, "BTreeIndex Line 224 Error");
 			return rc;
 		}
-		if((rc = leaf->write(1, pf)) < 0){
+		if((rc = leaf.write(nodeId, pf)) < 0){
             //fprintf(stderr, "BTreeIndex Line 227 Error");
 			return rc;
 		}
-		rootPid = 1;
+		rootPid = nodeId;
 		treeHeight = 1;
         splited = false;
 		return 0;
@@ -250,28 +466,38 @@ RC BTreeIndex::traverseInsert(int key, const RecordId& rid, PageId nodeId, int c
 	
 	if(cHeight >= treeHeight){
 		//reach leaf node
-		BTLeafNode* leaf = new BTLeafNode;
-		if((rc = leaf->read(nodeId, pf)) < 0){
+		BTLeafNode leaf;
+		if((rc = shadowNode(nodeId)) < 0){
+			return rc;
+		}
+		if((rc = leaf.read(nodeId, pf)) < 0){
 			return rc;
 		}
 		
-		if(leaf->getKeyCount() + 1 > branchingFactor){
+		if(leaf.getKeyCount() + 1 > branchingFactor){
 			//leaf node needs split
-			BTLeafNode* sibling = new BTLeafNode;
+			//the sibling is placed close to the node to keep scans sequential
+			BTLeafNode sibling;
 			int siblingKey;
-			PageId siblingPid = pf.endPid();
+			PageId siblingPid;
+			if((rc = allocateNode(siblingPid, nodeId)) < 0){
+				return rc;
+			}
+			if((rc = sibling.create(siblingPid, pf)) < 0){
+				return rc;
+			}
 			
-			if((rc = leaf->insertAndSplit(key, rid, *sibling, siblingKey)) < 0){
+			if((rc = leaf.insertAndSplit(key, rid, sibling, siblingKey)) < 0){
                 //fprintf(stderr, "BTreeIndex Line 252 Error");
 				return rc;
 			}
-			leaf->setNextNodePtr(siblingPid);
-			if((rc = leaf->write(nodeId, pf)) < 0){
+			leaf.setNextNodePtr(siblingPid);
+			if((rc = leaf.write(nodeId, pf)) < 0){
                 //fprintf(stderr, "BTreeIndex Line 256 Error");
 				return rc;
 			}	
 			
-			if((rc = sibling->write(siblingPid, pf)) < 0){
+			if((rc = sibling.write(siblingPid, pf)) < 0){
                 //fprintf(stderr, "BTreeIndex Line 260 Error");
 				return rc;
 			}			
@@ -283,10 +509,10 @@ RC BTreeIndex::traverseInsert(int key, const RecordId& rid, PageId nodeId, int c
 		
 		else{
 			//leaf node doesn't need split
-			if((rc = leaf->insert(key, rid)) < 0){
+			if((rc = leaf.insert(key, rid)) < 0){
 				return rc;
 				}
-			if((rc = leaf->write(nodeId, pf)) < 0){
+			if((rc = leaf.write(nodeId, pf)) < 0){
 				return rc;
 			}	
 			splited = false;
@@ -297,55 +523,82 @@ RC BTreeIndex::traverseInsert(int key, const RecordId& rid, PageId nodeId, int c
 	
 	if(cHeight < treeHeight){
 		//at non-leaf node
-		BTNonLeafNode* nonLeaf = new BTNonLeafNode;
-		if((rc = nonLeaf->read(nodeId, pf)) < 0){
+		pinNode(nodeId);
+		BTNonLeafNode nonLeaf;
+		if((rc = nonLeaf.read(nodeId, pf)) < 0){
 			return rc;
 		}
 		
 		PageId nextPid;
-		nonLeaf->locateChildPtr(key, nextPid);
+		nonLeaf.locateChildPtr(key, nextPid);
 		
 		cHeight++;
 		int rKey;
 		PageId rPid;
 		bool childSplited;
-		if((rc = traverseInsert(key, rid, nextPid, cHeight, rKey, rPid, childSplited)) < 0){
+		PageId childPid = nextPid;
+		if((rc = traverseInsert(key, rid, childPid, cHeight, rKey, rPid, childSplited)) < 0){
 			return rc;
 		}
 		
-		if(!childSplited)
+		if(!childSplited && childPid == nextPid)
 		{
 			splited = false;
 		}
+		else if(!childSplited)
+		{
+			//the child was copied: the node is copied as well to point to it
+			if((rc = shadowNode(nodeId)) < 0 || (rc = nonLeaf.read(nodeId, pf)) < 0){
+				return rc;
+			}
+			nonLeaf.replaceChildPtr(nextPid, childPid);
+			if((rc = nonLeaf.write(nodeId, pf)) < 0){
+				return rc;
+			}
+			splited = false;
+		}
 		else{
-			if(nonLeaf->getKeyCount() + 1 > branchingFactor)
+			if(shadow){
+				if((rc = shadowNode(nodeId)) < 0 || (rc = nonLeaf.read(nodeId, pf)) < 0){
+					return rc;
+				}
+				nonLeaf.replaceChildPtr(nextPid, childPid);
+			}
+			if(nonLeaf.getKeyCount() + 1 > branchingFactor)
 			{
 				//non-leaf node needs split
-				BTNonLeafNode* sibling = new BTNonLeafNode;
+				BTNonLeafNode sibling;
 				int midKey;
-				PageId siblingPid = pf.endPid();
+				PageId siblingPid;
+				if((rc = allocateNode(siblingPid, nodeId)) < 0){
+					return rc;
+				}
+				if((rc = sibling.create(siblingPid, pf)) < 0){
+					return rc;
+				}
 				
 				//if
-				if((rc = nonLeaf->insertAndSplit(rKey, rPid, *sibling, midKey)) < 0){
+				if((rc = nonLeaf.insertAndSplit(rKey, rPid, sibling, midKey)) < 0){
 					return rc;
 				}
-				if((rc = nonLeaf->write(nodeId, pf)) < 0){
+				if((rc = nonLeaf.write(nodeId, pf)) < 0){
 					return rc;
 				}	
 
-				if((rc = sibling->write(siblingPid, pf)) < 0){
+				if((rc = sibling.write(siblingPid, pf)) < 0){
 					return rc;
 				}
+				pinNode(siblingPid);
 				returnedPid = siblingPid;
 				returnedKey = midKey;
 				splited = true;
 			}
 			else{
 				//non-leaf node doesn't need split
-				if((rc = nonLeaf->insert(rKey, rPid)) < 0){
+				if((rc = nonLeaf.insert(rKey, rPid)) < 0){
 					return rc;
 				}
-				if((rc = nonLeaf->write(nodeId, pf)) < 0){
+				if((rc = nonLeaf.write(nodeId, pf)) < 0){
 					return rc;
 				}
                 splited = false;
@@ -365,20 +618,23 @@ RC BTreeIndex::traverseLocate(int searchKey, IndexCursor& cursor, PageId nodeId,
 
 	if(cHeight >= treeHeight){
 		//reach leaf node
-		BTLeafNode* leaf = new BTLeafNode;
-		if((rc = leaf->read(nodeId, pf)) < 0){
+		BTLeafNode leaf;
+		if((rc = leaf.read(nodeId, pf)) < 0){
 			return rc;
 		}
 		
 		int eid;
-		if((rc = leaf->locate(searchKey, eid)) < 0){
+		if((rc = leaf.locate(searchKey, eid)) < 0){
             cursor.pid = nodeId;
             cursor.eid = eid;
-            if(cursor.eid >= leaf->getKeyCount())
+            if(cursor.eid >= leaf.getKeyCount())
             {
                 //act the last entry of this node
                 
-                cursor.pid = leaf->getNextNodePtr();
+                if(!shadow)
+                    cursor.pid = leaf.getNextNodePtr();
+                else if(nextLeaf(searchKey, cursor.pid) < 0)
+                    cursor.pid = 0;
                 cursor.eid = 0;
             }
             return rc;
@@ -391,13 +647,14 @@ RC BTreeIndex::traverseLocate(int searchKey, IndexCursor& cursor, PageId nodeId,
 	}
 	else{
 		//at non-leaf node
-		BTNonLeafNode* nonLeaf = new BTNonLeafNode;
-		if((rc = nonLeaf->read(nodeId, pf)) < 0){
+		pinNode(nodeId);
+		BTNonLeafNode nonLeaf;
+		if((rc = nonLeaf.read(nodeId, pf)) < 0){
 			return rc;
 		}
 		
 		PageId nextPid;
-		if((rc = nonLeaf->locateChildPtr(searchKey, nextPid)) < 0){
+		if((rc = nonLeaf.locateChildPtr(searchKey, nextPid)) < 0){
 			return rc;
 		}
         //fprintf(stdout, "%d ////", nextPid);
@@ -405,3 +662,161 @@ RC BTreeIndex::traverseLocate(int searchKey, IndexCursor& cursor, PageId nodeId,
 		return traverseLocate(searchKey, cursor, nextPid, cHeight);
 	}
 }
+
+/*
+ * Keep the non-leaf node pinned in the buffer pool until the index is
+ * closed, unless the pin budget (or 1/8 of the buffer pool) is used up.
+ * @param pid[IN] the non-leaf node to pin
+ */
+void BTreeIndex::pinNode(PageId pid)
+{
+	char* page;
+	int size = pf.getPageSize();
+	
+	// a mapped file needs no buffer pool
+	if((pf.getFlags() & PageFile::MMAP) || pinnedNodes.count(pid) > 0)
+		return;
+	
+	long limit = (long)BufferPool::getPool(size).getFrameCount() * size / 8;
+	if(limit > pinBudget)
+		limit = pinBudget;
+	
+	// reserve the memory first; other indexes may be pinning concurrently
+	if(pinnedBytes.fetch_add(size) + size > limit){
+		pinnedBytes -= size;
+		return;
+	}
+	if(pf.pin(pid, page) < 0){
+		pinnedBytes -= size;
+		return;
+	}
+	pinnedNodes.insert(pid);
+}
+
+/*
+ * Release the pins taken by pinNode().
+ */
+void BTreeIndex::unpinNodes()
+{
+	for(set<PageId>::iterator it = pinnedNodes.begin(); it != pinnedNodes.end(); it++){
+		pf.unpin(*it);
+	}
+	pinnedBytes -= pinnedNodes.size() * pf.getPageSize();
+	pinnedNodes.clear();
+}
+
+/*
+ * Allocate the page of a new node. The nodes written since the last
+ * commit of a shadow-paged index are modified in place.
+ * @param pid[OUT] the page allocated
+ * @param near[IN] the page to allocate close to. -1 for any
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::allocateNode(PageId& pid, PageId near)
+{
+    RC rc;
+	
+	if((rc = pf.allocatePage(pid, near)) < 0)
+		return rc;
+	if(shadow){
+		freshPages.insert(pid);
+		insertPages.push_back(pid);
+	}
+	return 0;
+}
+
+/*
+ * Undo a failed insert() of a shadow-paged index: the pages allocated
+ * by the insert (copies and new nodes) are freed, and the nodes they
+ * were to replace stay in use. The root is left as it was.
+ * @param retired[IN] # retired pages before the insert
+ * @param rc[IN] the error of the insert
+ * @return rc
+ */
+RC BTreeIndex::abortInsert(size_t retired, RC rc)
+{
+	if(!shadow)
+		return rc;
+	
+	//the pins moved to the copies are taken again on the next traversals
+	unpinNodes();
+	for(vector<PageId>::iterator it = insertPages.begin(); it != insertPages.end(); it++){
+		freshPages.erase(*it);
+		pf.freePage(*it);
+	}
+	insertPages.clear();
+	retiredPages.resize(retired);
+	return rc;
+}
+
+/*
+ * Copy a node of the last commit of a shadow-paged index to a fresh page
+ * before it is modified. Nothing is done for the nodes written since the
+ * last commit, or if the index is not shadow-paged.
+ * @param pid[IN/OUT] the node; the page of its copy on return
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::shadowNode(PageId& pid)
+{
+    RC rc;
+	char page[PageFile::MAX_PAGE_SIZE];
+	PageId newPid;
+	
+	if(!shadow || freshPages.count(pid) > 0)
+		return 0;
+	
+	if((rc = pf.read(pid, page)) < 0 || (rc = allocateNode(newPid, pid)) < 0)
+		return rc;
+	if((rc = pf.write(newPid, page)) < 0)
+		return rc;
+	
+	//the copy takes over the pin of the node
+	if(pinnedNodes.erase(pid) > 0){
+		pf.unpin(pid);
+		pinnedBytes -= pf.getPageSize();
+		pinNode(newPid);
+	}
+	retiredPages.push_back(pid);
+	pid = newPid;
+	return 0;
+}
+
+/*
+ * Find the leaf that follows the leaf searchKey leads to, through the
+ * tree: the smallest key larger than searchKey met on the way down
+ * starts the next leaf.
+ * @param searchKey[IN] a key that leads to the leaf
+ * @param pid[OUT] the next leaf. 0 if the leaf is the last one
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::nextLeaf(int searchKey, PageId& pid)
+{
+    RC rc;
+	BTNonLeafNode nonLeaf;
+	PageId nodeId = rootPid;
+	int key, highKey;
+	bool bounded = false;
+	
+	for(int h = 1; h < treeHeight; h++){
+		if((rc = nonLeaf.read(nodeId, pf)) < 0)
+			return rc;
+		if(nonLeaf.locateUpperKey(searchKey, key) == 0){
+			highKey = key;
+			bounded = true;
+		}
+		nonLeaf.locateChildPtr(searchKey, nodeId);
+	}
+	if(!bounded){
+		pid = 0;
+		return 0;
+	}
+	
+	nodeId = rootPid;
+	for(int h = 1; h < treeHeight; h++){
+		if((rc = nonLeaf.read(nodeId, pf)) < 0)
+			return rc;
+		nonLeaf.locateChildPtr(highKey, nodeId);
+	}
+	pid = nodeId;
+	return 0;
+}
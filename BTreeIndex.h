@@ -10,6 +10,10 @@
 #ifndef BTREEINDEX_H
 #define BTREEINDEX_H
 
+#include <set>
+#include <vector>
+#include <atomic>
+#include <mutex>
 #include "Bruinbase.h"
 #include "PageFile.h"
 #include "RecordFile.h"
@@ -34,7 +38,23 @@ typedef struct {
 class BTreeIndex {
  public:
   
-  static const int BRANCHING_FACTOR = 80;
+  static const int BRANCHING_FACTOR = 80; // for PageFile::PAGE_SIZE pages
+
+  static const int DEFAULT_PIN_BUDGET = 256 * 1024; // see setPinBudget()
+
+  // shadow paging, an open option for a new index (next to the PageFile
+  // ones): a node of the last commit is never modified in place; it is
+  // copied to a fresh page first, and so are the nodes on its path up to
+  // the root. commit() publishes the new root through two header pages
+  // (0 and 1) that are written in turn, so a crash leaves the index as of
+  // the last commit. the header pages mark the file, which keeps shadow
+  // paging whenever it is opened. the pages replaced by commits are
+  // reused only after the index is closed, so an index opened in 'r'
+  // mode keeps the snapshot it opened while the writer has it open.
+  // since a leaf moves whenever it changes, the leaf chain of a
+  // shadow-paged index is not followed; the next leaf is found through
+  // the tree.
+  static const int SHADOW = 0x10000;
   
   BTreeIndex();
   
@@ -45,9 +65,10 @@ class BTreeIndex {
    * Under 'w' mode, the index file should be created if it does not exist.
    * @param indexname[IN] the name of the index file
    * @param mode[IN] 'r' for read, 'w' for write
+   * @param flags[IN] PageFile open options (e.g., PageFile::WRITE_BACK)
    * @return error code. 0 if no error
    */
-  RC open(const std::string& indexname, char mode);
+  RC open(const std::string& indexname, char mode, int flags = 0);
     RC readpagefilenode(PageId pid);
     RC readpagefilenonleafnode(PageId pid);
   /**
@@ -99,12 +120,63 @@ class BTreeIndex {
     
     PageId endPageNum();
     int endeidofLastpage();
+
+  /**
+   * take a checkpoint: write the dirty nodes of the index to the disk,
+   * then its metadata (rootPid and treeHeight, otherwise written only by
+   * close()) if it changed. indexes opened in 'w' mode are checkpointed
+   * by the background writer of the buffer pool (see
+   * BufferPool::setCheckpointInterval()), concurrently with insert().
+   * @return error code. 0 if no error
+   */
+  RC checkpoint();
+
+  /**
+   * commit the inserts since the last commit of a shadow-paged index:
+   * the new nodes are synced to the disk, then the header page with the
+   * new root. a checkpoint (see checkpoint()) of such an index is a
+   * commit, and so is close().
+   * @return error code. 0 if no error
+   */
+  RC commit();
+
+  /**
+   * @return true if the index is shadow-paged (see SHADOW)
+   */
+  bool isShadow() const { return shadow; }
+
+  /**
+   * set the memory budget for keeping non-leaf nodes (including the root)
+   * in the buffer pool. a non-leaf node is pinned the first time it is
+   * visited (or created by a split) and stays pinned until the index is
+   * closed, so that a lookup reads at most one leaf from the disk.
+   * the budget is shared by all open indexes, and the pinned nodes
+   * never take more than 1/8 of the buffer pool.
+   * @param bytes[IN] the budget in bytes. 0 disables pinning
+   */
+  static void setPinBudget(int bytes) { pinBudget = bytes; }
+
+  /**
+   * @return the memory budget for pinned non-leaf nodes in bytes
+   */
+  static int getPinBudget() { return pinBudget.load(); }
   
  private:
  
-  RC traverseInsert(int key, const RecordId& rid, PageId nodeId, int cHeight, int& returnedKey, PageId& returnedPid, bool& splited);
+  RC traverseInsert(int key, const RecordId& rid, PageId& nodeId, int cHeight, int& returnedKey, PageId& returnedPid, bool& splited);
   
   RC traverseLocate(int searchKey, IndexCursor& cursor, PageId nodeId, int cHeight);
+
+  void pinNode(PageId pid);  /// keep a non-leaf node pinned if the budget allows
+  void unpinNodes();         /// release all pinned non-leaf nodes
+  RC writeMetadata();       /// write rootPid, treeHeight, branchingFactor to page 0
+  static void checkpointed(void* index); /// the checkpoint of BufferPool
+  RC publish();             /// commit() with metaLatch held
+  RC allocateNode(PageId& pid, PageId near); /// allocate the page of a new node
+  RC shadowNode(PageId& pid);  /// copy a node of the last commit to a fresh page
+  RC abortInsert(size_t retired, RC rc); /// free the pages of a failed insert()
+  int  readHeader(PageId pid, char* page, long long& gen); /// read a header page
+  RC nextLeaf(int searchKey, PageId& pid); /// the leaf after the one of searchKey
  
   PageFile pf;         /// the PageFile used to store the actual b+tree in disk
 
@@ -117,6 +189,20 @@ class BTreeIndex {
   /// is opened again later.
   
   bool	   opened; ///whether the pagefile is currently open or not
+  PageId   savedRootPid; /// the rootPid last written to page 0
+  int      savedHeight;  /// the treeHeight last written to page 0
+  std::mutex metaLatch;  /// keeps checkpoint() out of insert()
+
+  bool     shadow;       /// true if the index is shadow-paged (see SHADOW)
+  long long generation;  /// the last commit; written to page generation % 2
+  std::set<PageId> freshPages;     /// the pages written since the last commit
+  std::vector<PageId> retiredPages; /// the pages replaced by the commits
+  std::vector<PageId> insertPages;  /// the pages allocated by the last insert()
+
+  std::set<PageId> pinnedNodes;  /// the non-leaf nodes pinned by pinNode()
+
+  static std::atomic<int> pinBudget;   /// see setPinBudget()
+  static std::atomic<int> pinnedBytes; /// the memory of all pinned nodes
 };
 
 #endif /* BTREEINDEX_H */
@@ -10,22 +10,89 @@ using namespace std;
  */
 BTLeafNode::BTLeafNode()
 {
+    buffer = NULL;
+    scratch = NULL;
+    file = NULL;
+    pagePid = -1;
+    pageSize = PageFile::PAGE_SIZE;
+    pidSize = sizeof(PageId);
+    entrySize = pidSize + 2 * sizeof(int);
     endEid = 0;
-    memset(buffer, 0, PageFile::PAGE_SIZE);
+}
+
+BTLeafNode::~BTLeafNode()
+{
+    release();
+    delete[] scratch;
+}
+
+void BTLeafNode::release()
+{
+    if(file != NULL)
+        file->unpin(pagePid);
+    buffer = NULL;
+    file = NULL;
+    pagePid = -1;
 }
 
 RC BTLeafNode::read(PageId pid, const PageFile& pf)
 { 
     RC rc;
-    if((rc = pf.read(pid, buffer)) < 0){
+    release();
+    if((rc = pf.pin(pid, buffer)) < 0){
         fprintf(stderr, "Error, unable to read leaf node");
+        buffer = NULL;
         return rc;
     }
+    bind(pf, pid);
     //endEid is stored in the last 4 bytes in the page.
     
-    memcpy(&endEid, buffer + PageFile::PAGE_SIZE - sizeof(int), sizeof(int));
+    memcpy(&endEid, buffer + pageSize - sizeof(int), sizeof(int));
     return rc;
 }
+
+RC BTLeafNode::create(PageId pid, PageFile& pf)
+{
+    RC rc;
+    release();
+    if((rc = pf.pinNew(pid, buffer)) < 0){
+        fprintf(stderr, "Error, unable to create leaf node");
+        buffer = NULL;
+        return rc;
+    }
+    bind(pf, pid);
+    endEid = 0;
+    return rc;
+}
+
+void BTLeafNode::bind(const PageFile& pf, PageId pid)
+{
+    file = &pf;
+    pagePid = pid;
+    pageSize = pf.getPageSize();
+    //the entries of files with 4-byte page ids are smaller
+    pidSize = pf.getPidSize();
+    entrySize = pidSize + 2 * sizeof(int);
+}
+
+void BTLeafNode::edit()
+{
+    //the frame keeps the content of the page until write() stores the
+    //changes, so that a change that is never written leaves no trace
+    if(buffer == scratch)
+        return;
+    if(scratch == NULL)
+        scratch = new char[PageFile::MAX_PAGE_SIZE];
+    memcpy(scratch, buffer, pageSize);
+    buffer = scratch;
+}
+
+int BTLeafNode::capacity(int pageSize, int pidSize)
+{
+    //(capacity + 1) entries and the next node pointer fit before endEid
+    int entrySize = pidSize + 2 * sizeof(int);
+    return (pageSize - (int)sizeof(int) - pidSize) / entrySize - 1;
+}
 int BTLeafNode::getendEid()
 {
     return endEid;
@@ -41,7 +108,8 @@ RC BTLeafNode::write(PageId pid, PageFile& pf)
 { 
   RC rc;
   
-  memcpy(buffer + PageFile::PAGE_SIZE - sizeof(int), &endEid, sizeof(int));
+  edit();
+  memcpy(buffer + pageSize - sizeof(int), &endEid, sizeof(int));
   if((rc = pf.write(pid, buffer)) < 0){
     fprintf(stderr, "Error, unable to write leaf node");
     return rc;
@@ -69,29 +137,30 @@ int BTLeafNode::getKeyCount()
 RC BTLeafNode::insert(int key, const RecordId& rid)
 {
   //each entry in leaf node is stored as (pid, sid, key) in sequence.
-  //each entry takes up 3 times size of int.
-  if((endEid + 1) * ENTRY_SIZE + sizeof(PageId) + sizeof(int) > PageFile::PAGE_SIZE){
+  //the pid takes pidSize bytes, sid and key the size of int each.
+  if((endEid + 1) * entrySize + pidSize + (int)sizeof(int) > pageSize){
     fprintf(stderr, "Error: exceed the capacity of the node");
     return RC_NODE_FULL;
   }
+  edit();
 
   //move the PageId at the end of page to the right.
-  memcpy(buffer + (endEid + 1) * ENTRY_SIZE, buffer + endEid * ENTRY_SIZE, sizeof(PageId));
+  memmove(entryAt(endEid + 1), entryAt(endEid), pidSize);
 
   int i;
   for(i = endEid - 1; i >= 0; i--){
     int entry_key;
-    memcpy(&entry_key, buffer + sizeof(RecordId) + i * ENTRY_SIZE, sizeof(int));
+    memcpy(&entry_key, keyAt(i), sizeof(int));
     if(entry_key > key){
       //move the entry to the right by one size of entry
-      memcpy(buffer + (i + 1) * ENTRY_SIZE, buffer + i * ENTRY_SIZE, ENTRY_SIZE); 
+      memmove(entryAt(i + 1), entryAt(i), entrySize); 
     }
     else
       break;
   }
-  memcpy(buffer + (i + 1) * ENTRY_SIZE, &rid.pid, sizeof(PageId));
-  memcpy(buffer + (i + 1) * ENTRY_SIZE + sizeof(PageId), &rid.sid, sizeof(int));
-  memcpy(buffer + (i + 1) * ENTRY_SIZE + sizeof(RecordId), &key, sizeof(int));
+  file->storePid(entryAt(i + 1), rid.pid);
+  memcpy(entryAt(i + 1) + pidSize, &rid.sid, sizeof(int));
+  memcpy(keyAt(i + 1), &key, sizeof(int));
   ++endEid;
     return 0;
  }
@@ -116,19 +185,17 @@ RC BTLeafNode::insertAndSplit(int key, const RecordId& rid,
   int i = int(endEid / 2);
   PageId pid;
   
-  memcpy(&siblingKey, buffer + i * ENTRY_SIZE + sizeof(RecordId), sizeof(int));
+  memcpy(&siblingKey, keyAt(i), sizeof(int));
     
    //// this.setNextNodePtr(&r.pid);
 
   //copy right half of the keys to sibling node
   for(i; i <=  endEid - 1; i++){
-    memcpy(&r.pid, buffer + i * ENTRY_SIZE, sizeof(PageId));
-    memcpy(&r.sid, buffer + i * ENTRY_SIZE + sizeof(PageId), sizeof(int));
-    memcpy(&k, buffer + i * ENTRY_SIZE + sizeof(RecordId), sizeof(int));
+    readEntry(i, k, r);
     sibling.insert(k, r);
   }
   //copy the ptr to next node to sibling node
-  memcpy(&pid, buffer + endEid * ENTRY_SIZE, sizeof(int));
+  pid = getNextNodePtr();
   sibling.setNextNodePtr(pid);
   
   endEid = int(endEid / 2);
@@ -154,14 +221,14 @@ RC BTLeafNode::locate(int searchKey, int& eid)
   int i = 0;
   int j = endEid - 1;
   
-  memcpy(&key, buffer + j * ENTRY_SIZE + sizeof(RecordId), sizeof(int));
+  memcpy(&key, keyAt(j), sizeof(int));
     if(searchKey > key){
         eid = endEid;
         return RC_NO_SUCH_RECORD;
     }
     while(j >= i + 1){
     int mid = (i + j) / 2;
-    memcpy(&key, buffer + mid * ENTRY_SIZE + sizeof(RecordId), sizeof(int));
+    memcpy(&key, keyAt(mid), sizeof(int));
     if(searchKey == key){
       eid = mid;
       return 0;
@@ -172,7 +239,7 @@ RC BTLeafNode::locate(int searchKey, int& eid)
       j = mid;
   }
     eid = j;
-    memcpy(&key, buffer + eid * ENTRY_SIZE + sizeof(RecordId), sizeof(int));
+    memcpy(&key, keyAt(eid), sizeof(int));
     if(searchKey == key)
         return 0;
   
@@ -191,9 +258,9 @@ RC BTLeafNode::readEntry(int eid, int& key, RecordId& rid)
   if(eid >= endEid || eid < 0)
       return RC_INVALID_CURSOR;
       
-  memcpy(&rid.pid, buffer + eid * ENTRY_SIZE, sizeof(PageId));
-  memcpy(&rid.sid, buffer + eid * ENTRY_SIZE + sizeof(PageId), sizeof(int));
-  memcpy(&key, buffer + eid * ENTRY_SIZE + sizeof(RecordId), sizeof(int));
+  rid.pid = file->loadPid(entryAt(eid));
+  memcpy(&rid.sid, entryAt(eid) + pidSize, sizeof(int));
+  memcpy(&key, keyAt(eid), sizeof(int));
 
   return 0;
 }
@@ -204,9 +271,7 @@ RC BTLeafNode::readEntry(int eid, int& key, RecordId& rid)
  */
 PageId BTLeafNode::getNextNodePtr()
 { 
-  PageId pid;
-  memcpy(&pid, buffer + endEid * ENTRY_SIZE, sizeof(PageId));
-  return pid; 
+  return file->loadPid(entryAt(endEid)); 
 }
 
 
@@ -218,7 +283,8 @@ PageId BTLeafNode::getNextNodePtr()
  */
 RC BTLeafNode::setNextNodePtr(PageId pid)
 {
-  memcpy(buffer + endEid * ENTRY_SIZE, &pid, sizeof(PageId));
+  edit();
+  file->storePid(entryAt(endEid), pid);
   return 0; 
 }
 
@@ -231,9 +297,9 @@ void BTLeafNode::printNodeContent()
 	for(int i = 0; i < endEid; i++)
 	{
 		readEntry(i, key, rid);
-		fprintf(stdout, "key: %d, rid: (%d, %d) | ", key, rid.pid, rid.sid);
+		fprintf(stdout, "key: %d, rid: (%lld, %d) | ", key, rid.pid, rid.sid);
 	}
-	fprintf(stdout, "next page id: %d\n", getNextNodePtr());
+	fprintf(stdout, "next page id: %lld\n", getNextNodePtr());
 	fprintf(stdout, "number of keys: %d\n", endEid);
 
 
@@ -247,19 +313,85 @@ void BTLeafNode::printNodeContent()
  */
 BTNonLeafNode::BTNonLeafNode()
 {
-    memset(buffer, 0, PageFile::PAGE_SIZE);
+    buffer = NULL;
+    scratch = NULL;
+    file = NULL;
+    pagePid = -1;
+    pageSize = PageFile::PAGE_SIZE;
+    pidSize = sizeof(PageId);
+    pairSize = pidSize + sizeof(int);
     keyCount = 0;
 }
+
+BTNonLeafNode::~BTNonLeafNode()
+{
+    release();
+    delete[] scratch;
+}
+
+void BTNonLeafNode::release()
+{
+    if(file != NULL)
+        file->unpin(pagePid);
+    buffer = NULL;
+    file = NULL;
+    pagePid = -1;
+}
+
 RC BTNonLeafNode::read(PageId pid, const PageFile& pf)
 { 
   RC rc;
-  if((rc = pf.read(pid, buffer)) < 0){
+  release();
+  if((rc = pf.pin(pid, buffer)) < 0){
     fprintf(stderr, "Error, unable to read nonleaf node");
+    buffer = NULL;
     return rc;
   }
-  memcpy(&keyCount, buffer + PageFile::PAGE_SIZE - sizeof(int), sizeof(int));
+  bind(pf, pid);
+  memcpy(&keyCount, buffer + pageSize - sizeof(int), sizeof(int));
   return rc;
 }
+
+RC BTNonLeafNode::create(PageId pid, PageFile& pf)
+{
+  RC rc;
+  release();
+  if((rc = pf.pinNew(pid, buffer)) < 0){
+    fprintf(stderr, "Error, unable to create nonleaf node");
+    buffer = NULL;
+    return rc;
+  }
+  bind(pf, pid);
+  keyCount = 0;
+  return rc;
+}
+
+void BTNonLeafNode::bind(const PageFile& pf, PageId pid)
+{
+  file = &pf;
+  pagePid = pid;
+  pageSize = pf.getPageSize();
+  pidSize = pf.getPidSize();
+  pairSize = pidSize + sizeof(int);
+}
+
+void BTNonLeafNode::edit()
+{
+  //the frame keeps the content of the page until write() stores the
+  //changes, so that a change that is never written leaves no trace
+  if(buffer == scratch)
+    return;
+  if(scratch == NULL)
+    scratch = new char[PageFile::MAX_PAGE_SIZE];
+  memcpy(scratch, buffer, pageSize);
+  buffer = scratch;
+}
+
+int BTNonLeafNode::capacity(int pageSize, int pidSize)
+{
+  //(capacity + 2) pids, (capacity + 1) keys and keyCount fit in a page
+  return pageSize / (pidSize + (int)sizeof(int)) - 2;
+}
     
 /*
  * Write the content of the node to the page pid in the PageFile pf.
@@ -270,7 +402,8 @@ RC BTNonLeafNode::read(PageId pid, const PageFile& pf)
 RC BTNonLeafNode::write(PageId pid, PageFile& pf)
 {
   RC rc;
-  memcpy(buffer + PageFile::PAGE_SIZE - sizeof(int), &keyCount, sizeof(int));
+  edit();
+  memcpy(buffer + pageSize - sizeof(int), &keyCount, sizeof(int));
   if((rc = pf.write(pid, buffer)) < 0){
     fprintf(stderr, "Error, unable to write nonleaf node");
     return rc;
@@ -297,26 +430,27 @@ RC BTNonLeafNode::insert(int key, PageId pid)
   //data stored in buffer is in the form of pid|key|pid|key|...|pid
   //key is sorted
   
-  if((keyCount + 2) * sizeof(int) + (keyCount + 2) * sizeof(PageId) > PageFile::PAGE_SIZE){
+  if((keyCount + 2) * pairSize > pageSize){
     fprintf(stderr, "Error: exceed the capacity of the node");
     return RC_NODE_FULL;
   }
+  edit();
 
   int i;
   for(i = keyCount - 1; i>= 0; i--){
     int k;
-    memcpy(&k, buffer + (i + 1) * sizeof(PageId) + i * sizeof(int), sizeof(int));
+    memcpy(&k, keyAt(i), sizeof(int));
     if(k > key){
       //move the (key|pid) pair to the right
-      memcpy(buffer + (i + 2) * sizeof(PageId) + (i + 1) * sizeof(int), buffer + (i + 1) * sizeof(PageId) + i * sizeof(int), sizeof(PageId) + sizeof(int));
+      memmove(keyAt(i + 1), keyAt(i), pairSize);
     }
     else
       break;
   }
 
   //put the (key|pid) pair to be inserted into the right place
-  memcpy(buffer + (i + 2) * sizeof(PageId) + (i + 1) * sizeof(int), &key, sizeof(int));
-  memcpy(buffer + (i + 2) * (sizeof(PageId) + sizeof(int)), &pid, sizeof(PageId));
+  memcpy(keyAt(i + 1), &key, sizeof(int));
+  file->storePid(pidAt(i + 2), pid);
 
   ++keyCount;
     return 0;
@@ -343,14 +477,14 @@ RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, in
   int k;
   PageId p;
   int i = int(keyCount / 2);
-  memcpy(&midKey, buffer + (i + 1) * sizeof(PageId) + i * sizeof(int), sizeof(int));
+  memcpy(&midKey, keyAt(i), sizeof(int));
 
-  memcpy(&p, buffer + (i + 1) * (sizeof(PageId) + sizeof(int)), sizeof(PageId));
+  p = file->loadPid(pidAt(i + 1));
   sibling.setFirstPid(p);
     
   for(i = i + 1; i <= keyCount - 1; i++){
-    memcpy(&k, buffer + (i + 1) * sizeof(PageId) + i * sizeof(int), sizeof(int));
-    memcpy(&p, buffer + (i + 1) * (sizeof(PageId) + sizeof(int)), sizeof(PageId));
+    memcpy(&k, keyAt(i), sizeof(int));
+    p = file->loadPid(pidAt(i + 1));
     sibling.insert(k, p);
   }
   
@@ -361,7 +495,8 @@ RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, in
 
 RC BTNonLeafNode::setFirstPid(PageId pid)
 {
-  memcpy(buffer, &pid, sizeof(PageId));
+  edit();
+  file->storePid(pidAt(0), pid);
   return 0;
 }
 
@@ -382,9 +517,9 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
   while(j >= i + 1){
     mid = (i + j) / 2;
     int key;
-    memcpy(&key, buffer + (mid + 1) * sizeof(PageId) + mid * sizeof(int), sizeof(int));
+    memcpy(&key, keyAt(mid), sizeof(int));
     if(searchKey == key){
-      memcpy(&pid, buffer + (mid + 1) * (sizeof(PageId) + sizeof(int)), sizeof(PageId));
+      pid = file->loadPid(pidAt(mid + 1));
       return 0;
     }
     if(searchKey > key)
@@ -395,18 +530,52 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
   
   int keyi;
   int keyj;
-  memcpy(&keyi, buffer + (i + 1) * sizeof(PageId) + i * sizeof(int), sizeof(int));
-  memcpy(&keyj, buffer + (j + 1) * sizeof(PageId) + j * sizeof(int), sizeof(int));
+  memcpy(&keyi, keyAt(i), sizeof(int));
+  memcpy(&keyj, keyAt(j), sizeof(int));
   if(searchKey < keyi)
-    memcpy(&pid, buffer + i * (sizeof(PageId) + sizeof(int)), sizeof(PageId));
+    pid = file->loadPid(pidAt(i));
   else if(searchKey >= keyj)
-    memcpy(&pid, buffer + (j + 1) * (sizeof(PageId) + sizeof(int)), sizeof(PageId));
+    pid = file->loadPid(pidAt(j + 1));
   else
-    memcpy(&pid, buffer + (i + 1) * (sizeof(PageId) + sizeof(int)), sizeof(PageId));
+    pid = file->loadPid(pidAt(i + 1));
   return 0;
 
 }
 
+/*
+ * Find the smallest key in the node that is larger than searchKey.
+ * @param searchKey[IN] the searchKey that is being looked up.
+ * @param key[OUT] the key found.
+ * @return 0 if successful. RC_NO_SUCH_RECORD if no key is larger.
+ */
+RC BTNonLeafNode::locateUpperKey(int searchKey, int& key)
+{
+  for(int i = 0; i < keyCount; i++){
+    memcpy(&key, keyAt(i), sizeof(int));
+    if(key > searchKey)
+      return 0;
+  }
+  return RC_NO_SUCH_RECORD;
+}
+
+/*
+ * Replace a child-node pointer with another PageId.
+ * @param pid[IN] the PageId to replace
+ * @param newPid[IN] the PageId to store instead
+ * @return 0 if successful. RC_NO_SUCH_RECORD if pid is not in the node.
+ */
+RC BTNonLeafNode::replaceChildPtr(PageId pid, PageId newPid)
+{
+  for(int i = 0; i <= keyCount; i++){
+    if(file->loadPid(pidAt(i)) == pid){
+      edit();
+      file->storePid(pidAt(i), newPid);
+      return 0;
+    }
+  }
+  return RC_NO_SUCH_RECORD;
+}
+
 /*
  * Initialize the root node with (pid1, key, pid2).
  * @param pid1[IN] the first PageId to insert
@@ -416,9 +585,10 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
  */
 RC BTNonLeafNode::initializeRoot(PageId pid1, int key, PageId pid2)
 { 
-  memcpy(buffer, &pid1, sizeof(PageId));
-  memcpy(buffer + sizeof(PageId), &key, sizeof(int));
-  memcpy(buffer + sizeof(PageId) + sizeof(int), &pid2, sizeof(int));
+  edit();
+  file->storePid(pidAt(0), pid1);
+  memcpy(keyAt(0), &key, sizeof(int));
+  file->storePid(pidAt(1), pid2);
   
   keyCount = 1;
 
@@ -433,12 +603,12 @@ void BTNonLeafNode::printNodeContent()
 
 	for(int i = 0; i < keyCount; i++)
 	{
-		memcpy(&pid, buffer + i * sizeof(PageId) + i * sizeof(int), sizeof(PageId));
-		memcpy(&key, buffer + (i + 1) * sizeof(PageId) + i * sizeof(int), sizeof(int));
-		fprintf(stdout, "page id: %d | key: %d | ", pid, key);
+		pid = file->loadPid(pidAt(i));
+		memcpy(&key, keyAt(i), sizeof(int));
+		fprintf(stdout, "page id: %lld | key: %d | ", pid, key);
 	}
-	memcpy(&pid, buffer + keyCount * sizeof(PageId) + keyCount * sizeof(int), sizeof(PageId));
-	fprintf(stdout, "page id: %d\n", pid);
+	pid = file->loadPid(pidAt(keyCount));
+	fprintf(stdout, "page id: %lld\n", pid);
 	fprintf(stdout, "number of keys: %d\n", keyCount);
 
 
@@ -19,9 +19,8 @@
 class BTLeafNode {
   public:
   
-  static const int ENTRY_SIZE = sizeof(RecordId) + sizeof(int);
-  
     BTLeafNode();
+    ~BTLeafNode();
   /**
     * Insert the (key, rid) pair to the node.
     * Remember that all keys inside a B+tree node should be kept sorted.
@@ -86,11 +85,26 @@ class BTLeafNode {
  
    /**
     * Read the content of the node from the page pid in the PageFile pf.
+    * The node becomes a view of the page's frame in the buffer pool,
+    * which stays pinned until the node is destroyed or bound to
+    * another page; the page is copied only once the node is changed,
+    * and the frame is updated only by write().
     * @param pid[IN] the PageId to read
     * @param pf[IN] PageFile to read from
     * @return 0 if successful. Return an error code if there is an error.
     */
     RC read(PageId pid, const PageFile& pf);
+
+   /**
+    * Bind the node to a new, empty page pid in the PageFile pf.
+    * Nothing is read from the disk; the page is created when the
+    * node is written. A node must be bound by read() or create()
+    * before its content is accessed.
+    * @param pid[IN] the PageId of the new node
+    * @param pf[IN] PageFile the node will be written to
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC create(PageId pid, PageFile& pf);
     
    /**
     * Write the content of the node to the page pid in the PageFile pf.
@@ -102,15 +116,42 @@ class BTLeafNode {
 
 	void printNodeContent();
     int getendEid();
+
+   /**
+    * Return the largest number of keys a leaf node can hold such that
+    * one more key can still be inserted by insertAndSplit().
+    * @param pageSize[IN] the page size of the index (PageFile::getPageSize())
+    * @param pidSize[IN] the size of a stored PageId (PageFile::getPidSize())
+    * @return the number of keys
+    */
+    static int capacity(int pageSize, int pidSize);
 	
   private:
    /**
-    * The main memory buffer for loading the content of the disk page 
-    * that contains the node.
+    * The buffer-pool frame holding the content of the disk page
+    * that contains the node. The node does not own the frame.
+    * Once the node is changed, its copy in scratch instead.
     */
-    char buffer[PageFile::PAGE_SIZE];
+    char* buffer;
+    char* scratch;        // the copy of the page the changes are made in,
+                          // stored by write(). NULL until the node changes
+    const PageFile* file; // the PageFile the frame is pinned in
+    PageId pagePid;       // the page the frame is pinned for
+    int pageSize;         // the size of the page. the capacity of the
+                          // node depends on it
+    int pidSize;          // the size of a PageId stored in the page
+    int entrySize;        // the size of an entry: (pid, sid, key)
     //note the last entry id in the node is actually endEid - 1.
     int endEid;
+
+    void bind(const PageFile& pf, PageId pid);
+    void edit();
+    char* entryAt(int eid) const { return buffer + eid * entrySize; }
+    char* keyAt(int eid) const { return entryAt(eid) + pidSize + sizeof(int); }
+
+    BTLeafNode(const BTLeafNode&);
+    BTLeafNode& operator=(const BTLeafNode&);
+    void release();
 	
 }; 
 
@@ -122,6 +163,7 @@ class BTNonLeafNode {
   public:
   
     BTNonLeafNode();
+    ~BTNonLeafNode();
    /**
     * Insert a (key, pid) pair to the node.
     * Remember that all keys inside a B+tree node should be kept sorted.
@@ -155,6 +197,23 @@ class BTNonLeafNode {
     */
     RC locateChildPtr(int searchKey, PageId& pid);
 
+   /**
+    * Find the smallest key in the node that is larger than searchKey,
+    * i.e., the key that ends the subtree locateChildPtr() follows.
+    * @param searchKey[IN] the searchKey that is being looked up.
+    * @param key[OUT] the key found.
+    * @return 0 if successful. RC_NO_SUCH_RECORD if no key is larger.
+    */
+    RC locateUpperKey(int searchKey, int& key);
+
+   /**
+    * Replace a child-node pointer, e.g., by the page of a copy of the child.
+    * @param pid[IN] the PageId to replace
+    * @param newPid[IN] the PageId to store instead
+    * @return 0 if successful. RC_NO_SUCH_RECORD if pid is not in the node.
+    */
+    RC replaceChildPtr(PageId pid, PageId newPid);
+
    /**
     * Initialize the root node with (pid1, key, pid2).
     * @param pid1[IN] the first PageId to insert
@@ -172,11 +231,26 @@ class BTNonLeafNode {
 
    /**
     * Read the content of the node from the page pid in the PageFile pf.
+    * The node becomes a view of the page's frame in the buffer pool,
+    * which stays pinned until the node is destroyed or bound to
+    * another page; the page is copied only once the node is changed,
+    * and the frame is updated only by write().
     * @param pid[IN] the PageId to read
     * @param pf[IN] PageFile to read from
     * @return 0 if successful. Return an error code if there is an error.
     */
     RC read(PageId pid, const PageFile& pf);
+
+   /**
+    * Bind the node to a new, empty page pid in the PageFile pf.
+    * Nothing is read from the disk; the page is created when the
+    * node is written. A node must be bound by read() or create()
+    * before its content is accessed.
+    * @param pid[IN] the PageId of the new node
+    * @param pf[IN] PageFile the node will be written to
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC create(PageId pid, PageFile& pf);
     
    /**
     * Write the content of the node to the page pid in the PageFile pf.
@@ -195,14 +269,41 @@ class BTNonLeafNode {
 	
 	void printNodeContent();
 
+   /**
+    * Return the largest number of keys a nonleaf node can hold such that
+    * one more key can still be inserted by insertAndSplit().
+    * @param pageSize[IN] the page size of the index (PageFile::getPageSize())
+    * @param pidSize[IN] the size of a stored PageId (PageFile::getPidSize())
+    * @return the number of keys
+    */
+    static int capacity(int pageSize, int pidSize);
+
   private:
    /**
-    * The main memory buffer for loading the content of the disk page 
-    * that contains the node.
+    * The buffer-pool frame holding the content of the disk page
+    * that contains the node. The node does not own the frame.
+    * Once the node is changed, its copy in scratch instead.
     */
-    char buffer[PageFile::PAGE_SIZE];
+    char* buffer;
+    char* scratch;        // the copy of the page the changes are made in,
+                          // stored by write(). NULL until the node changes
+    const PageFile* file; // the PageFile the frame is pinned in
+    PageId pagePid;       // the page the frame is pinned for
+    int pageSize;         // the size of the page. the capacity of the
+                          // node depends on it
+    int pidSize;          // the size of a PageId stored in the page
+    int pairSize;         // the size of a (pid, key) pair
 
     int keyCount;
+
+    void bind(const PageFile& pf, PageId pid);
+    void edit();
+    char* pidAt(int i) const { return buffer + i * pairSize; }
+    char* keyAt(int i) const { return buffer + i * pairSize + pidSize; }
+
+    BTNonLeafNode(const BTNonLeafNode&);
+    BTNonLeafNode& operator=(const BTNonLeafNode&);
+    void release();
 }; 
 
 #endif /* BTNODE_H */
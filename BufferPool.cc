@@ -0,0 +1,1058 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "Bruinbase.h"
+#include "BufferPool.h"
+#include "AsyncIO.h"
+#include "IOStats.h"
+#include "WriteAheadLog.h"
+
+std::atomic<BufferPool*> BufferPool::pools[BufferPool::POOL_COUNT];
+int BufferPool::poolSize = BufferPool::DEFAULT_FRAME_COUNT;
+std::string BufferPool::policyName = "lru";
+bool BufferPool::hugePages = false;
+size_t BufferPool::compressedSize = 0;
+std::mutex BufferPool::poolLatch;
+std::atomic<long long> BufferPool::hitCount(0);
+std::atomic<long long> BufferPool::missCount(0);
+std::atomic<long long> BufferPool::compressedHitCount(0);
+std::atomic<int> BufferPool::writeRun(BufferPool::DEFAULT_WRITE_RUN);
+std::atomic<long long> BufferPool::writerPageCount(0);
+thread_local const BufferPool::Frame* BufferPool::lastPinned = NULL;
+
+// the state of the background writer (see setWriterInterval()). like the
+// I/O engine, it is never deleted, since its detached thread may still be
+// waiting on it when the process exits.
+struct BackgroundWriter {
+  std::mutex latch;        // protects the members below
+  std::condition_variable wake; // signaled when the intervals change
+  int  interval;           // msecs between writer rounds. 0 if none
+  int  checkpointInterval; // msecs between checkpoints. 0 if none
+  bool running;            // true while the thread is alive
+  std::mutex checkpointLatch; // protects checkpoints, held while they run
+  std::vector<std::pair<void (*)(void*), void*> > checkpoints;
+
+  BackgroundWriter() : interval(0), checkpointInterval(0), running(false) {}
+};
+
+static BackgroundWriter& getWriter()
+{
+  static BackgroundWriter* writer = new BackgroundWriter;
+  return *writer;
+}
+
+BufferPool::BufferPool(int pageSize, int frameCount)
+  : tier(pageSize, compressedSize)
+{
+  this->pageSize = pageSize;
+  init(frameCount);
+}
+
+BufferPool::~BufferPool()
+{
+  release();
+}
+
+void BufferPool::init(int count)
+{
+  int i, nbuckets;
+
+  if (count < MIN_FRAME_COUNT) count = MIN_FRAME_COUNT;
+  frameCount = count;
+
+  frames = new Frame[frameCount];
+
+  // every frame is aligned to the page size (and the memory at least to
+  // FRAME_ALIGNMENT) so that frames can be used for direct I/O
+  // (like new, fail loudly when out of memory)
+  size_t size = (size_t)frameCount * pageSize;
+  if (!hugePages || size < HUGE_PAGE_SIZE || !allocateHuge(size)) {
+    void* p;
+    int align = (pageSize > FRAME_ALIGNMENT) ? pageSize : FRAME_ALIGNMENT;
+    if (posix_memalign(&p, align, size) != 0) {
+      throw std::bad_alloc();
+    }
+    memory = (char*)p;
+    memorySize = 0;
+    memoryKind = HEAP;
+  }
+
+  // keep the load factor of the hash table at or below 1/2
+  for (nbuckets = 1; nbuckets < 2 * frameCount; nbuckets <<= 1);
+  bucketMask = nbuckets - 1;
+  buckets = new std::atomic<int>[nbuckets];
+  for (i = 0; i < nbuckets; i++) buckets[i] = -1;
+
+  // every frame starts out free (frame 0 is used first). a free frame
+  // is "loading", so that no lookup without the latch pins it.
+  freeFrames.clear();
+  for (i = frameCount - 1; i >= 0; i--) {
+    frames[i].file = NULL;
+    frames[i].pid = -1;
+    frames[i].data = memory + (size_t)i * pageSize;
+    frames[i].hashNext = -1;
+    frames[i].state = LOADING;
+    frames[i].dirty = false;
+    frames[i].lsn = 0;
+    frames[i].uses = 0;
+    frames[i].lastUse = 0;
+    frames[i].evictedFile = NULL;
+    freeFrames.push_back(i);
+  }
+  for (i = 0; i < PIN_STRIPES; i++) pinnedCounts[i].count = 0;
+  useClock = 0;
+
+  policy = ReplacementPolicy::create(policyName, frameCount);
+}
+
+bool BufferPool::allocateHuge(size_t size)
+{
+  void* p;
+
+  // whole huge pages (which are also aligned enough for direct I/O)
+  size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+#ifdef MAP_HUGETLB
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) {
+    memory = (char*)p;
+    memorySize = size;
+    memoryKind = HUGETLB;
+    return true;
+  }
+#endif
+
+#ifdef MADV_HUGEPAGE
+  // no huge pages reserved: ask for transparent huge pages. the kernel
+  // only uses them for 2MB-aligned ranges, so map an extra huge page
+  // and cut the mapping down to an aligned range
+  p = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) return false;
+
+  char* start = (char*)p;
+  char* aligned = (char*)(((uintptr_t)start + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+  if (aligned > start) munmap(start, aligned - start);
+  munmap(aligned + size, start + HUGE_PAGE_SIZE - aligned);
+
+  madvise(aligned, size, MADV_HUGEPAGE);
+  memory = aligned;
+  memorySize = size;
+  memoryKind = THP;
+  return true;
+#else
+  return false;
+#endif
+}
+
+const char* BufferPool::getMemoryKind() const
+{
+  switch (memoryKind) {
+  case HUGETLB: return "hugetlb";
+  case THP:     return "thp";
+  default:      return "heap";
+  }
+}
+
+void BufferPool::release()
+{
+  delete policy;
+  delete [] frames;
+  if (memoryKind == HEAP) free(memory);
+  else munmap(memory, memorySize);
+  delete [] buckets;
+  policy = NULL;
+  frames = NULL;
+  memory = NULL;
+  buckets = NULL;
+}
+
+void BufferPool::setReplacement(const std::string& name)
+{
+  std::unique_lock<std::mutex> lock(latch);
+
+  delete policy;
+  policy = ReplacementPolicy::create(name, frameCount);
+
+  // tell the new policy about the cached pages. the pinned ones become
+  // candidates when they are unpinned (see relist()).
+  for (int f = 0; f < frameCount; f++) {
+    if (frames[f].file == NULL) continue;
+    policy->loaded(f, pageKeyOf(frames[f].file, frames[f].pid), true);
+    frames[f].state |= UNLISTED;
+    relist(f);
+  }
+}
+
+RC BufferPool::resize(int count)
+{
+  RC rc;
+  std::unique_lock<std::mutex> lock(latch);
+
+  // write back the dirty pages (a flush may let new pages get dirty)
+  for (;;) {
+    if (getPinnedCount() > 0) return RC_INVALID_ATTRIBUTE;
+    std::vector<int> list;
+    for (int f = 0; f < frameCount; f++) {
+      if (frames[f].dirty) list.push_back(f);
+    }
+    if (list.empty()) break;
+    if ((rc = flush(lock, list)) < 0) return rc;
+  }
+
+  release();
+  init(count);
+  return 0;
+}
+
+uint64_t BufferPool::keyOf(const PageFile* file, PageId pid)
+{
+  // mix the file address and the page id (multiplicative hashing)
+  uint64_t h = (uint64_t)(uintptr_t)file ^ ((uint64_t)pid * 0x9e3779b97f4a7c15ULL);
+  return h ^ (h >> 29);
+}
+
+uint64_t BufferPool::pageKeyOf(const PageFile* file, PageId pid)
+{
+  // unlike keyOf(), the same for every PageFile that opens the file, so
+  // that the policy knows a page read again after the file was reopened
+  uint64_t h = file->fileId ^ ((uint64_t)pid * 0x9e3779b97f4a7c15ULL);
+  return h ^ (h >> 29);
+}
+
+int BufferPool::bucketOf(const PageFile* file, PageId pid) const
+{
+  return (int)(keyOf(file, pid) & bucketMask);
+}
+
+int BufferPool::find(const PageFile* file, PageId pid) const
+{
+  for (int f = buckets[bucketOf(file, pid)]; f >= 0; f = frames[f].hashNext) {
+    if (frames[f].file == file && frames[f].pid == pid) return f;
+  }
+  return -1;
+}
+
+int BufferPool::tryPin(const PageFile* file, PageId pid)
+{
+  int steps = 0;
+
+  // the chains may change meanwhile (a frame may even move to another
+  // chain), so the walk is cut short after frameCount frames. a page not
+  // found here is looked up again under the latch.
+  for (int f = buckets[bucketOf(file, pid)].load(std::memory_order_acquire);
+       f >= 0 && steps++ < frameCount;
+       f = frames[f].hashNext.load(std::memory_order_acquire)) {
+    Frame& fr = frames[f];
+    uint64_t s = fr.state.load(std::memory_order_acquire);
+    uint64_t version = s & ~(VERSION - 1);
+    if (fr.file.load(std::memory_order_acquire) != file || fr.pid.load(std::memory_order_acquire) != pid) continue;
+
+    // repeated pins of a page by the same thread (e.g., one per tuple of
+    // a scan) count as a single reference
+    uint64_t ref = (&fr == lastPinned) ? 0 : REFERENCED;
+    do {
+      if ((s & ~(VERSION - 1)) != version || (s & LOADING) || (s & PIN_MASK) == PIN_MASK) return -1;
+    } while (!fr.state.compare_exchange_weak(s, (s + 1) | ref, std::memory_order_acquire));
+
+    if ((s & PIN_MASK) == 0) countPinned(f, 1);
+    lastPinned = &fr;
+    fr.uses.fetch_add(1, std::memory_order_relaxed);
+    fr.lastUse.store(useClock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return f;
+  }
+  return -1;
+}
+
+bool BufferPool::tryUnpin(const PageFile* file, PageId pid)
+{
+  int steps = 0;
+
+  // as in tryPin(), a frame that changed is left to the latch
+  for (int f = buckets[bucketOf(file, pid)].load(std::memory_order_acquire);
+       f >= 0 && steps++ < frameCount;
+       f = frames[f].hashNext.load(std::memory_order_acquire)) {
+    Frame& fr = frames[f];
+    uint64_t s = fr.state.load(std::memory_order_acquire);
+    uint64_t version = s & ~(VERSION - 1);
+    if (fr.file.load(std::memory_order_acquire) != file || fr.pid.load(std::memory_order_acquire) != pid) continue;
+
+    do {
+      if ((s & ~(VERSION - 1)) != version || (s & LOADING)) return false;
+      if ((s & PIN_MASK) == 0) return true;
+    } while (!fr.state.compare_exchange_weak(s, s - 1, std::memory_order_release));
+
+    // the last pin of a frame that is no candidate of the policy
+    if ((s & PIN_MASK) == 1) {
+      countPinned(f, -1);
+      if (s & UNLISTED) {
+        std::unique_lock<std::mutex> lock(latch);
+        relist(f);
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+void BufferPool::countPinned(int f, int delta)
+{
+  pinnedCounts[f % PIN_STRIPES].count.fetch_add(delta, std::memory_order_relaxed);
+}
+
+int BufferPool::getPinnedCount() const
+{
+  int n = 0;
+  for (int i = 0; i < PIN_STRIPES; i++) n += pinnedCounts[i].count.load(std::memory_order_relaxed);
+  return n;
+}
+
+void BufferPool::relist(int f)
+{
+  uint64_t s = frames[f].state.load();
+
+  // a frame becomes a candidate of the policy again once it is unpinned
+  // and ready, whoever gets here first
+  do {
+    if ((s & PIN_MASK) || (s & LOADING) || !(s & UNLISTED)) return;
+  } while (!frames[f].state.compare_exchange_weak(s, s & ~(UNLISTED | REFERENCED)));
+  policy->unpinned(f);
+}
+
+int BufferPool::claimVictim()
+{
+  // the policy does not see the pins taken without the latch: a pinned
+  // candidate stops being one until it is unpinned, and a candidate
+  // pinned since it became one goes back to the policy as if it had
+  // just been unpinned (once every frame had this second chance, the
+  // references are ignored, so that hits cannot starve the eviction)
+  bool swept = false;
+
+  for (int tries = 0; ; tries++) {
+    int f = policy->victim();
+    if (f < 0) {
+      // the frames unpinned without the latch may not be candidates
+      // yet (their unpinners wait for the latch to relist them)
+      if (swept) return -1;
+      swept = true;
+      for (f = 0; f < frameCount; f++) relist(f);
+      continue;
+    }
+
+    uint64_t s = frames[f].state.load();
+    if (s & PIN_MASK) {
+      if (frames[f].state.compare_exchange_strong(s, s | UNLISTED)) policy->pinned(f);
+    } else if ((s & REFERENCED) && tries < frameCount) {
+      if (frames[f].state.compare_exchange_strong(s, s & ~REFERENCED)) {
+        policy->pinned(f);
+        policy->unpinned(f);
+      }
+    } else if (frames[f].state.compare_exchange_strong(s, ((s | (VERSION - 1)) + 1) | LOADING | UNLISTED | 1)) {
+      // the frame is pinned and loading, and its version changed, so
+      // that it is no longer found without the latch
+      countPinned(f, 1);
+      return f;
+    }
+  }
+}
+
+void BufferPool::unhash(int f)
+{
+  std::atomic<int>* p = &buckets[bucketOf(frames[f].file, frames[f].pid)];
+  while (*p != f) p = &frames[*p].hashNext;
+  p->store(frames[f].hashNext.load());
+
+  frames[f].file = NULL;
+  frames[f].pid = -1;
+  frames[f].hashNext = -1;
+}
+
+int BufferPool::findReady(std::unique_lock<std::mutex>& lock, const PageFile* file, PageId pid)
+{
+  int f;
+
+  // wait while another thread is filling in the frame of the page
+  while ((f = find(file, pid)) >= 0 && (frames[f].state & LOADING)) loaded.wait(lock);
+  return f;
+}
+
+void BufferPool::pinFrame(int f)
+{
+  // a pinned frame cannot be evicted until it is unpinned
+  if ((frames[f].state.fetch_add(1) & PIN_MASK) == 0) countPinned(f, 1);
+}
+
+void BufferPool::touch(int f)
+{
+  // the page was looked up: it is a bit hotter (see hottestPages()).
+  // as in tryPin(), repeated pins by the same thread are one reference.
+  frames[f].uses++;
+  frames[f].lastUse = ++useClock;
+  if (&frames[f] != lastPinned) frames[f].state |= REFERENCED;
+  lastPinned = &frames[f];
+}
+
+void BufferPool::unpinFrame(int f)
+{
+  uint64_t s = frames[f].state.fetch_sub(1);
+
+  if ((s & PIN_MASK) == 1) {
+    countPinned(f, -1);
+    relist(f);
+  }
+}
+
+void BufferPool::drop(int f)
+{
+  uint64_t s = frames[f].state.load();
+
+  // the frame becomes free, so that it is reused first. the pins go
+  // with the page, and the new version tells the lookups without the
+  // latch that the frame changed.
+  while (!frames[f].state.compare_exchange_weak(s, ((s | (VERSION - 1)) + 1) | LOADING));
+  if (s & PIN_MASK) countPinned(f, -1);
+  frames[f].dirty = false;
+  frames[f].lsn = 0;
+  unhash(f);
+  policy->dropped(f);
+  freeFrames.push_back(f);
+}
+
+char* BufferPool::pin(const PageFile* file, PageId pid)
+{
+  int f;
+
+  // a cached page that is ready is pinned without the latch
+  if ((f = tryPin(file, pid)) >= 0) return frames[f].data;
+
+  std::unique_lock<std::mutex> lock(latch);
+  if ((f = findReady(lock, file, pid)) < 0) return NULL;
+
+  pinFrame(f);
+  touch(f);
+  return frames[f].data;
+}
+
+char* BufferPool::allocate(const PageFile* file, PageId pid, bool* fresh, RC* rc)
+{
+  int f;
+  RC r;
+
+  if (fresh != NULL) *fresh = false;
+
+  // the page may already be cached; reuse its frame
+  if ((f = tryPin(file, pid)) >= 0) {
+    hitCount++;
+    IOStats::countHit(file->stats);
+    return frames[f].data;
+  }
+
+  std::unique_lock<std::mutex> lock(latch);
+  if ((f = findReady(lock, file, pid)) >= 0) {
+    pinFrame(f);
+    touch(f);
+    hitCount++;
+    IOStats::countHit(file->stats);
+    return frames[f].data;
+  }
+
+  if ((f = assign(file, pid, true, r)) < 0) {
+    if (rc != NULL && r < 0) *rc = r;
+    return NULL;
+  }
+  missCount++;
+  IOStats::countMiss(file->stats);
+  stash(lock, f);
+
+  // the old content is not needed if the caller overwrites the page
+  if (fresh == NULL) tier.drop(file, pid);
+  else *fresh = !fillFromTier(lock, f);
+  return frames[f].data;
+}
+
+char* BufferPool::allocateAbsent(const PageFile* file, PageId pid)
+{
+  int f;
+  RC rc;
+  std::unique_lock<std::mutex> lock(latch);
+
+  // keep most of the frames for the pages that are being used
+  if (getPinnedCount() >= frameCount / 4) return NULL;
+
+  if (find(file, pid) >= 0 || (f = assign(file, pid, false, rc)) < 0) return NULL;
+  stash(lock, f);
+
+  // a page found in the compressed tier needs no reading
+  if (fillFromTier(lock, f)) {
+    unpinFrame(f);
+    return NULL;
+  }
+  return frames[f].data;
+}
+
+int BufferPool::assign(const PageFile* file, PageId pid, bool referenced, RC& rc)
+{
+  const PageFile* victim;
+  int f, b;
+
+  // use a free frame, or evict the page chosen by the policy.
+  // a dirty victim is written back before its frame is reused, after
+  // the log record of its last change.
+  rc = 0;
+  if (!freeFrames.empty()) {
+    f = freeFrames.back();
+    freeFrames.pop_back();
+    frames[f].state = ((frames[f].state | (VERSION - 1)) + 1) | LOADING | UNLISTED | 1;
+    countPinned(f, 1);
+  } else {
+    for (int tries = 0; ; tries++) {
+      if ((f = claimVictim()) < 0) return -1;
+      victim = frames[f].file;
+      if (!frames[f].dirty) break;
+
+      if (frames[f].lsn == 0 || (rc = WriteAheadLog::flush(frames[f].lsn)) == 0) {
+        victim->seal(frames[f].data);
+        rc = victim->writePage(frames[f].pid, frames[f].data, true);
+      }
+      if (rc == 0) {
+        frames[f].dirty = false;
+        frames[f].lsn = 0;
+        break;
+      }
+
+      // the frame keeps its page, and goes to the end of the line so
+      // that the next candidate is tried (each frame at most once)
+      frames[f].state = (frames[f].state | (VERSION - 1)) + 1;
+      countPinned(f, -1);
+      policy->pinned(f);
+      policy->unpinned(f);
+      if (tries + 1 >= frameCount) return -1;
+    }
+    rc = 0;
+    IOStats::countEviction(victim->stats);
+    if (tier.getCapacity() > 0) {
+      // the caller compresses the page into the tier (see stash())
+      frames[f].evictedFile = victim;
+      frames[f].evictedPid = frames[f].pid;
+      frames[f].evictedTicket = tier.reserve(victim, frames[f].pid);
+    }
+    policy->evicted(f);
+    unhash(f);
+  }
+
+  // register the frame for the new page. the frame is pinned and
+  // loading until the caller calls ready().
+  b = bucketOf(file, pid);
+  frames[f].file = file;
+  frames[f].pid = pid;
+  frames[f].hashNext = buckets[b].load();
+  frames[f].uses = referenced ? 1 : 0;
+  frames[f].lastUse = referenced ? ++useClock : 0;
+  if (referenced) lastPinned = &frames[f];
+  buckets[b] = f;
+  policy->loaded(f, pageKeyOf(file, pid), referenced);
+
+  return f;
+}
+
+void BufferPool::stash(std::unique_lock<std::mutex>& lock, int f)
+{
+  std::vector<char> data;
+  const PageFile* file = frames[f].evictedFile;
+  PageId pid = frames[f].evictedPid;
+  long long ticket = frames[f].evictedTicket;
+
+  if (file == NULL) return;
+  frames[f].evictedFile = NULL;
+
+  // the frame still holds the evicted (clean) page until the caller fills
+  // it in, so it is compressed outside of the latch
+  lock.unlock();
+  tier.compress(frames[f].data, data);
+  lock.lock();
+  tier.fill(file, pid, ticket, data);
+}
+
+bool BufferPool::fillFromTier(std::unique_lock<std::mutex>& lock, int f)
+{
+  std::vector<char> data;
+  const PageFile* file = frames[f].file;
+
+  if (tier.getCapacity() == 0 || !tier.take(file, frames[f].pid, data)) return false;
+
+  // like a disk read, decompress outside of the latch while the frame
+  // is loading. it stays pinned, so it is not reused meanwhile.
+  lock.unlock();
+  bool ok = tier.decompress(data, frames[f].data);
+  lock.lock();
+  if (!ok) return false;
+
+  frames[f].state &= ~LOADING;
+  loaded.notify_all();
+  compressedHitCount++;
+  IOStats::countCompressedHit(file->stats);
+  return true;
+}
+
+void BufferPool::ready(const PageFile* file, PageId pid)
+{
+  std::unique_lock<std::mutex> lock(latch);
+
+  int f = find(file, pid);
+  if (f < 0 || !(frames[f].state & LOADING)) return;
+
+  frames[f].state &= ~LOADING;
+  relist(f);
+  loaded.notify_all();
+}
+
+void BufferPool::discard(const PageFile* file, PageId pid)
+{
+  std::unique_lock<std::mutex> lock(latch);
+
+  int f = find(file, pid);
+  if (f < 0) return;
+
+  drop(f);
+  loaded.notify_all();
+}
+
+void BufferPool::unpin(const PageFile* file, PageId pid)
+{
+  if (tryUnpin(file, pid)) return;
+
+  std::unique_lock<std::mutex> lock(latch);
+
+  int f = find(file, pid);
+  if (f < 0 || (frames[f].state & PIN_MASK) == 0) return;
+
+  unpinFrame(f);
+}
+
+void BufferPool::markDirty(const PageFile* file, PageId pid, long long lsn)
+{
+  std::unique_lock<std::mutex> lock(latch);
+
+  int f = find(file, pid);
+  if (f < 0) return;
+  frames[f].dirty = true;
+  if (lsn > frames[f].lsn) frames[f].lsn = lsn;
+}
+
+RC BufferPool::flush(std::unique_lock<std::mutex>& lock, const std::vector<int>& list)
+{
+  RC rc = 0, r;
+  WriteList order, chunk;
+  unsigned i, j, share = std::max(frameCount / FLUSH_SHARE, 1);
+
+  // write the pages in the order of (file, pid) so that the disk sees
+  // (mostly) sequential writes
+  for (i = 0; i < list.size(); i++) {
+    Frame& fr = frames[list[i]];
+    order.push_back(std::make_pair(std::make_pair(fr.file.load(), fr.pid.load()), list[i]));
+  }
+  std::sort(order.begin(), order.end());
+
+  // the pages are pinned while they are written, so write a share of
+  // the frames at a time to leave the others to allocate()
+  for (i = 0; i < order.size(); i += share) {
+    chunk.clear();
+    for (j = i; j < order.size() && j < i + share; j++) {
+      // the page may have been written or evicted during the last chunk
+      Frame& fr = frames[order[j].second];
+      if (fr.file == order[j].first.first && fr.pid == order[j].first.second && fr.dirty) chunk.push_back(order[j]);
+    }
+    if ((r = writeRuns(lock, chunk)) < 0) rc = r;
+  }
+  return rc;
+}
+
+RC BufferPool::writeRuns(std::unique_lock<std::mutex>& lock, const WriteList& order)
+{
+  RC rc = 0;
+  IOBatch batch;
+  std::vector<struct iovec> iov;
+  unsigned i, n, maxRun = writeRun.load();
+  long long lsn = 0;
+
+  // the frames are pinned so that they are not evicted while being
+  // written. a page modified in the meantime simply becomes dirty again.
+  for (i = 0; i < order.size(); i++) {
+    Frame& fr = frames[order[i].second];
+    pinFrame(order[i].second);
+    fr.dirty = false;
+    lsn = std::max(lsn, fr.lsn);
+    fr.lsn = 0;
+    fr.file.load()->seal(fr.data);
+  }
+
+  // each run of consecutive pages of a file is written with one I/O.
+  // the tag of a request is the position of its first page in order.
+  for (i = 0; i < order.size(); i += n) {
+    const PageFile* file = order[i].first.first;
+    PageId first = order[i].first.second;
+
+    iov.clear();
+    for (n = 0; i + n < order.size() && n < maxRun; n++) {
+      if (order[i + n].first.first != file || order[i + n].first.second != first + (PageId)n) break;
+      struct iovec v = { frames[order[i + n].second].data, (size_t)pageSize };
+      iov.push_back(v);
+    }
+    if (n == 1) batch.addWrite(file->fd, iov[0].iov_base, pageSize, file->offset(first), NULL, file, i);
+    else batch.addWritev(file->fd, &iov[0], n, file->offset(first), NULL, file, i);
+  }
+
+  // submit all writes at once and wait for them outside of the latch,
+  // once the log records of the pages (and of their old content, if they
+  // changed since the last commit) are durable
+  lock.unlock();
+  bool logged = true;
+  for (i = 0; logged && i < order.size(); i++) {
+    long long undo;
+    logged = (order[i].first.first->saveUndo(order[i].first.second, undo) == 0);
+    lsn = std::max(lsn, undo);
+  }
+  logged = logged && (lsn == 0 || WriteAheadLog::flush(lsn) == 0);
+  if (logged) {
+    batch.submit();
+    batch.wait();
+  }
+  lock.lock();
+
+  for (int r = 0; r < batch.size(); r++) {
+    const IORequest& req = batch.getRequest(r);
+    unsigned written = 0;
+    n = req.iov.empty() ? 1 : (unsigned)req.iov.size();
+
+    for (i = (unsigned)req.tag; i < (unsigned)req.tag + n; i++) {
+      int f = order[i].second;
+
+      // the file may have been closed by another thread in the meantime
+      if (frames[f].file != req.arg || frames[f].pid != order[i].first.second || (frames[f].state & PIN_MASK) == 0) continue;
+
+      if (!logged || req.result != (ssize_t)req.len) {
+        frames[f].dirty = true;
+        rc = RC_FILE_WRITE_FAILED;
+      } else {
+        PageFile::writeCount++;
+        IOStats::countWrite(frames[f].file.load()->stats, req.latency);
+        if (written++ == 0) IOStats::countWriteCall(frames[f].file.load()->stats, req.len);
+      }
+      unpinFrame(f);
+    }
+  }
+  return rc;
+}
+
+void BufferPool::writeOldest()
+{
+  std::vector<std::pair<long long, int> > dirty;
+  std::vector<int> list;
+  std::unique_lock<std::mutex> lock(latch);
+
+  // a pinned page is in use, and may be half modified
+  for (int f = 0; f < frameCount; f++) {
+    if (frames[f].dirty && (frames[f].state & PIN_MASK) == 0) dirty.push_back(std::make_pair(frames[f].lastUse.load(), f));
+  }
+
+  // the pages used the longest time ago are the closest to eviction and
+  // the least likely to be modified again soon
+  unsigned n = std::min(dirty.size(), (size_t)std::max(frameCount / FLUSH_SHARE, 1));
+  std::partial_sort(dirty.begin(), dirty.begin() + n, dirty.end());
+  for (unsigned i = 0; i < n; i++) list.push_back(dirty[i].second);
+  if (list.empty()) return;
+
+  // a failed write leaves the page dirty, to be written on eviction
+  flush(lock, list);
+  writerPageCount += n;
+}
+
+RC BufferPool::flushFile(const PageFile* file)
+{
+  std::vector<int> list;
+  std::unique_lock<std::mutex> lock(latch);
+
+  for (int f = 0; f < frameCount; f++) {
+    if (frames[f].dirty && frames[f].file == file) list.push_back(f);
+  }
+  return flush(lock, list);
+}
+
+RC BufferPool::flushAll()
+{
+  std::vector<int> list;
+  std::unique_lock<std::mutex> lock(latch);
+
+  for (int f = 0; f < frameCount; f++) {
+    if (frames[f].dirty) list.push_back(f);
+  }
+  return flush(lock, list);
+}
+
+void BufferPool::invalidate(const PageFile* file, PageId pid)
+{
+  std::unique_lock<std::mutex> lock(latch);
+
+  tier.drop(file, pid);
+
+  // a page pinned without the latch meanwhile is kept
+  int f = find(file, pid);
+  if (f < 0) return;
+  uint64_t s = frames[f].state.load();
+  if ((s & PIN_MASK) || !frames[f].state.compare_exchange_strong(s, s | LOADING)) return;
+
+  drop(f);
+}
+
+void BufferPool::invalidateFile(const PageFile* file)
+{
+  std::unique_lock<std::mutex> lock(latch);
+
+  for (int f = 0; f < frameCount; f++) {
+    if (frames[f].file == file) drop(f);
+  }
+  tier.dropFile(file);
+  loaded.notify_all();
+}
+
+void BufferPool::hottestPages(const PageFile* file, int max, std::vector<PageId>& pids)
+{
+  std::vector<std::pair<std::pair<int, long long>, PageId> > pages;
+  pids.clear();
+  if (max <= 0) return;
+
+  std::unique_lock<std::mutex> lock(latch);
+  for (int f = 0; f < frameCount; f++) {
+    if (frames[f].file != file || (frames[f].state & LOADING)) continue;
+    pages.push_back(std::make_pair(std::make_pair(frames[f].uses.load(), frames[f].lastUse.load()), frames[f].pid.load()));
+  }
+  lock.unlock();
+
+  // sort by (uses, lastUse), hottest first
+  if ((int)pages.size() > max) {
+    std::partial_sort(pages.begin(), pages.begin() + max, pages.end(),
+                      std::greater<std::pair<std::pair<int, long long>, PageId> >());
+    pages.resize(max);
+  } else {
+    std::sort(pages.begin(), pages.end(),
+              std::greater<std::pair<std::pair<int, long long>, PageId> >());
+  }
+
+  for (size_t i = 0; i < pages.size(); i++) pids.push_back(pages[i].second);
+}
+
+int BufferPool::poolIndex(int pageSize)
+{
+  int i = 0;
+  while ((PageFile::PAGE_SIZE << i) < pageSize) i++;
+  return i;
+}
+
+BufferPool& BufferPool::getPool(int pageSize)
+{
+  std::atomic<BufferPool*>& slot = pools[poolIndex(pageSize)];
+  BufferPool* p = slot.load(std::memory_order_acquire);
+  if (p != NULL) return *p;
+
+  std::unique_lock<std::mutex> lock(poolLatch);
+  if ((p = slot.load(std::memory_order_relaxed)) == NULL) {
+    p = new BufferPool(pageSize, poolSize);
+    slot.store(p, std::memory_order_release);
+  }
+  return *p;
+}
+
+RC BufferPool::setPoolSize(int frameCount)
+{
+  RC rc;
+  std::unique_lock<std::mutex> lock(poolLatch);
+
+  if (frameCount < MIN_FRAME_COUNT) return RC_INVALID_ATTRIBUTE;
+  for (int i = 0; i < POOL_COUNT; i++) {
+    BufferPool* p = pools[i].load(std::memory_order_acquire);
+    if (p != NULL && (rc = p->resize(frameCount)) < 0) return rc;
+  }
+
+  poolSize = frameCount;
+  return 0;
+}
+
+RC BufferPool::setPolicy(const std::string& name)
+{
+  std::unique_lock<std::mutex> lock(poolLatch);
+
+  ReplacementPolicy* probe = ReplacementPolicy::create(name, MIN_FRAME_COUNT);
+  if (probe == NULL) return RC_INVALID_ATTRIBUTE;
+  delete probe;
+
+  for (int i = 0; i < POOL_COUNT; i++) {
+    BufferPool* p = pools[i].load(std::memory_order_acquire);
+    if (p != NULL) p->setReplacement(name);
+  }
+
+  policyName = name;
+  return 0;
+}
+
+std::string BufferPool::getPolicy()
+{
+  std::unique_lock<std::mutex> lock(poolLatch);
+  return policyName;
+}
+
+void BufferPool::setWriteRun(int pages)
+{
+  writeRun = (pages < 1) ? 1 : (pages > MAX_WRITE_RUN) ? MAX_WRITE_RUN : pages;
+}
+
+void BufferPool::runWriter()
+{
+  BackgroundWriter& w = getWriter();
+  std::chrono::steady_clock::time_point lastCheckpoint = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(w.latch);
+
+  IOStats::nameThread("background writer");
+  for (;;) {
+    // sleep until the next round or checkpoint, whichever is sooner
+    int interval = w.interval, checkpointInterval = w.checkpointInterval;
+    if (interval <= 0 && checkpointInterval <= 0) break;
+    int msecs = (interval > 0 && (checkpointInterval <= 0 || interval < checkpointInterval)) ? interval : checkpointInterval;
+    if (w.wake.wait_for(lock, std::chrono::milliseconds(msecs)) == std::cv_status::no_timeout) continue;
+    interval = w.interval;
+    checkpointInterval = w.checkpointInterval;
+    lock.unlock();
+
+    if (interval > 0) {
+      for (int i = 0; i < POOL_COUNT; i++) {
+        BufferPool* pool = pools[i].load(std::memory_order_acquire);
+        if (pool != NULL) pool->writeOldest();
+      }
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (checkpointInterval > 0 && now - lastCheckpoint >= std::chrono::milliseconds(checkpointInterval)) {
+      std::unique_lock<std::mutex> guard(w.checkpointLatch);
+      for (unsigned i = 0; i < w.checkpoints.size(); i++) w.checkpoints[i].first(w.checkpoints[i].second);
+      lastCheckpoint = now;
+    }
+    lock.lock();
+  }
+  w.running = false;
+}
+
+void BufferPool::setWriterInterval(int msecs)
+{
+  BackgroundWriter& w = getWriter();
+  std::unique_lock<std::mutex> lock(w.latch);
+
+  w.interval = (msecs > 0) ? msecs : 0;
+  w.wake.notify_all();
+  if (w.interval > 0 && !w.running) {
+    w.running = true;
+    std::thread(&BufferPool::runWriter).detach();
+  }
+}
+
+int BufferPool::getWriterInterval()
+{
+  BackgroundWriter& w = getWriter();
+  std::unique_lock<std::mutex> lock(w.latch);
+  return w.interval;
+}
+
+void BufferPool::setCheckpointInterval(int msecs)
+{
+  BackgroundWriter& w = getWriter();
+  std::unique_lock<std::mutex> lock(w.latch);
+
+  w.checkpointInterval = (msecs > 0) ? msecs : 0;
+  w.wake.notify_all();
+  if (w.checkpointInterval > 0 && !w.running) {
+    w.running = true;
+    std::thread(&BufferPool::runWriter).detach();
+  }
+}
+
+int BufferPool::getCheckpointInterval()
+{
+  BackgroundWriter& w = getWriter();
+  std::unique_lock<std::mutex> lock(w.latch);
+  return w.checkpointInterval;
+}
+
+void BufferPool::addCheckpoint(void (*checkpoint)(void*), void* arg)
+{
+  BackgroundWriter& w = getWriter();
+  std::unique_lock<std::mutex> lock(w.checkpointLatch);
+  w.checkpoints.push_back(std::make_pair(checkpoint, arg));
+}
+
+void BufferPool::removeCheckpoint(void* arg)
+{
+  BackgroundWriter& w = getWriter();
+  std::unique_lock<std::mutex> lock(w.checkpointLatch);
+
+  for (unsigned i = 0; i < w.checkpoints.size(); i++) {
+    if (w.checkpoints[i].second != arg) continue;
+    w.checkpoints.erase(w.checkpoints.begin() + i);
+    return;
+  }
+}
+
+RC BufferPool::setHugePages(bool enable)
+{
+  RC rc;
+  std::unique_lock<std::mutex> lock(poolLatch);
+
+  // the pools are reallocated by resize(), which reads hugePages
+  bool old = hugePages;
+  hugePages = enable;
+  for (int i = 0; i < POOL_COUNT; i++) {
+    BufferPool* p = pools[i].load(std::memory_order_acquire);
+    if (p != NULL && (rc = p->resize(p->getFrameCount())) < 0) {
+      hugePages = old;
+      return rc;
+    }
+  }
+  return 0;
+}
+
+void BufferPool::setCompressedSize(size_t bytes)
+{
+  std::unique_lock<std::mutex> lock(poolLatch);
+
+  for (int i = 0; i < POOL_COUNT; i++) {
+    BufferPool* p = pools[i].load(std::memory_order_acquire);
+    if (p == NULL) continue;
+    std::unique_lock<std::mutex> poolLock(p->latch);
+    p->tier.setCapacity(bytes);
+  }
+  compressedSize = bytes;
+}
+
+size_t BufferPool::getCompressedSize()
+{
+  std::unique_lock<std::mutex> lock(poolLatch);
+  return compressedSize;
+}
+
+bool BufferPool::getHugePages()
+{
+  std::unique_lock<std::mutex> lock(poolLatch);
+  return hugePages;
+}
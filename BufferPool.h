@@ -0,0 +1,455 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "Bruinbase.h"
+#include "PageFile.h"
+#include "ReplacementPolicy.h"
+#include "CompressedCache.h"
+
+/**
+ * a pool of page frames shared by all open PageFiles of one page size.
+ * a frame is located through a hash table keyed by (file, pid).
+ * free frames are used first; after that, the frame to recycle is chosen
+ * by a ReplacementPolicy (LRU by default, see setPolicy()).
+ * a frame handed out by pin() or allocate() is pinned: it is never
+ * evicted until every pin on it is released by unpin().
+ * a frame marked dirty is written back to its file before its frame
+ * is reused, or when its file is flushed. a flush submits all the writes
+ * as one asynchronous batch (see AsyncIO.h), writing each run of
+ * consecutive pages of a file with a single I/O (see setWriteRun()).
+ * a background writer thread (see setWriterInterval()) may trickle the
+ * dirty pages out ahead of eviction, oldest first, and take periodic
+ * checkpoints (see addCheckpoint()).
+ * pages evicted from the pool may be kept compressed in a second tier
+ * (see CompressedCache.h and setCompressedSize()), which is looked up
+ * before a page is read from the disk.
+ * all functions are thread-safe. a page that is cached is pinned and
+ * unpinned without the latch of the pool: the hash chains are followed
+ * optimistically, and a single compare-and-swap of the state word of the
+ * frame (see Frame) both pins it and validates that it still holds the
+ * page. everything else (misses, eviction, flushes, frames being loaded)
+ * is protected by the latch; disk reads into newly allocated frames and
+ * flushes are done outside of it (see allocate() and ready()).
+ * since the hits bypass the latch, the replacement policy learns about
+ * them lazily: a frame pinned without the latch stays among the victim
+ * candidates, and the eviction skips it (it is pinned) or gives it a
+ * second chance (it was pinned since it became a candidate).
+ */
+class BufferPool {
+ public:
+
+  static const int DEFAULT_FRAME_COUNT = 1024; // 1MB of 1KB pages
+  static const int MIN_FRAME_COUNT = 16;
+  static const int FRAME_ALIGNMENT = 4096; // the alignment of the frame memory
+  static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024; // see setHugePages()
+  static const int DEFAULT_WRITE_RUN = 64; // see setWriteRun()
+  static const int MAX_WRITE_RUN = 1024;    // IOV_MAX on Linux
+  static const int FLUSH_SHARE = 8;  // a flush pins 1/8 of the frames at a time
+
+  // # page sizes, i.e., # shared pools (PageFile::PAGE_SIZE to
+  // PageFile::MAX_PAGE_SIZE in powers of two)
+  static const int POOL_COUNT = 5;
+
+  /**
+   * create a pool of frameCount frames of pageSize bytes each.
+   * @param pageSize[IN] the size of a frame
+   * @param frameCount[IN] the number of frames
+   */
+  BufferPool(int pageSize, int frameCount);
+  ~BufferPool();
+
+  /**
+   * look up the frame that caches the page (file, pid) and pin it.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page to look up
+   * @return the frame buffer. NULL if the page is not cached
+   */
+  char* pin(const PageFile* file, PageId pid);
+
+  /**
+   * assign a pinned frame to the page (file, pid), evicting the page
+   * chosen by the replacement policy if no frame is free. if the page is already
+   * cached, its frame is pinned and returned. otherwise the content
+   * of the returned frame is undefined: the caller fills it in and then
+   * calls ready() (or discard() on failure). until then, other threads
+   * looking up the page wait for the content.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page to cache
+   * @param fresh[OUT] if not NULL, set to true if a new frame was assigned
+   * @param rc[OUT] if not NULL, set to the error code of writing back a
+   *                dirty page when that is why no frame was assigned
+   * @return the frame buffer. NULL if every frame is pinned, or no dirty
+   *         page could be written back
+   */
+  char* allocate(const PageFile* file, PageId pid, bool* fresh = NULL, RC* rc = NULL);
+
+  /**
+   * like allocate(), but only for a page that is not cached at all.
+   * this never waits for another thread, so it may be called while
+   * holding frames that are still being filled in.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page to cache
+   * @return the new frame buffer. NULL if the page is cached (or being
+   *         loaded), or if a quarter of the frames are already pinned
+   */
+  char* allocateAbsent(const PageFile* file, PageId pid);
+
+  /**
+   * declare that the content of a frame obtained by allocate() is valid,
+   * waking up threads waiting for the page.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page that was filled in
+   */
+  void ready(const PageFile* file, PageId pid);
+
+  /**
+   * give up a frame obtained by allocate() whose content could not be
+   * filled in. the pin is released and the page is dropped.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page to drop
+   */
+  void discard(const PageFile* file, PageId pid);
+
+  /**
+   * release one pin on the frame of the page (file, pid).
+   * the frame may be evicted once its last pin is released.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page to unpin
+   */
+  void unpin(const PageFile* file, PageId pid);
+
+  /**
+   * mark the pinned frame of the page (file, pid) dirty, i.e., newer
+   * than the page on the disk.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page that was modified
+   * @param lsn[IN] the log record of the change, which must be durable
+   *                before the page is written (see WriteAheadLog.h). 0 if none
+   */
+  void markDirty(const PageFile* file, PageId pid, long long lsn = 0);
+
+  /**
+   * write every dirty page of the file back to the disk in the order
+   * of pid. each page is written once no matter how many times it was
+   * modified since it became dirty.
+   * @param file[IN] the file to flush
+   * @return error code. 0 if no error
+   */
+  RC flushFile(const PageFile* file);
+
+  /**
+   * write every dirty page in the pool back to the disk.
+   * @return error code. 0 if no error
+   */
+  RC flushAll();
+
+  /**
+   * drop the page (file, pid) from the pool if it is cached and unpinned,
+   * and from the compressed tier.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page to drop
+   */
+  void invalidate(const PageFile* file, PageId pid);
+
+  /**
+   * drop every cached page of the file, including pinned and dirty ones.
+   * call flushFile() first to keep the changes.
+   * @param file[IN] the file whose pages are dropped
+   */
+  void invalidateFile(const PageFile* file);
+
+  /**
+   * list the cached pages of the file, hottest first: by # lookups
+   * (pin() and allocate()) since the page was cached, then by the time
+   * of the last lookup. pages read ahead but never looked up come last.
+   * @param file[IN] the file whose pages are listed
+   * @param max[IN] the maximum # pages to list
+   * @param pids[OUT] the pages
+   */
+  void hottestPages(const PageFile* file, int max, std::vector<PageId>& pids);
+
+  /**
+   * change the number of frames. dirty pages are written back and
+   * all cached pages are dropped. this fails if any frame is pinned.
+   * @param frameCount[IN] the new number of frames
+   * @return error code. 0 if no error
+   */
+  RC resize(int frameCount);
+
+  /**
+   * @return the number of frames in the pool
+   */
+  int getFrameCount() const { return frameCount; }
+
+  /**
+   * @param pageSize[IN] the page size
+   * @return the pool shared by all PageFiles with pages of pageSize bytes
+   */
+  static BufferPool& getPool(int pageSize = PageFile::PAGE_SIZE);
+
+  /**
+   * set the number of frames of every shared pool. pools that have not
+   * been created yet are created with this size. existing pools are
+   * reallocated, so no other thread may be using them (the lookups of
+   * cached pages do not take the latch).
+   * @param frameCount[IN] the number of frames
+   * @return error code. 0 if no error
+   */
+  static RC setPoolSize(int frameCount);
+
+  /**
+   * choose the replacement policy of every shared pool (see
+   * ReplacementPolicy::create() for the names). the pages cached
+   * so far are kept.
+   * @param name[IN] the name of the policy
+   * @return error code. 0 if no error
+   */
+  static RC setPolicy(const std::string& name);
+
+  /**
+   * @return the name of the replacement policy of the shared pools
+   */
+  static std::string getPolicy();
+
+  /**
+   * back the frames of every shared pool with 2MB huge pages, to cut the
+   * TLB misses of random accesses to a large pool. explicit huge pages
+   * (MAP_HUGETLB, which must be reserved in /proc/sys/vm/nr_hugepages)
+   * are tried first, then transparent huge pages (madvise MADV_HUGEPAGE),
+   * then ordinary memory. pools smaller than a huge page are not
+   * affected. existing pools are reallocated, so this fails if any
+   * frame is pinned.
+   * @param enable[IN] true to use huge pages, false not to
+   * @return error code. 0 if no error
+   */
+  static RC setHugePages(bool enable);
+
+  /**
+   * @return true if the shared pools use huge pages (see setHugePages())
+   */
+  static bool getHugePages();
+
+  /**
+   * set the memory of the compressed tier of every shared pool. pages
+   * evicted from a pool are compressed into its tier, and a page missing
+   * from the pool is taken from the tier if it is there.
+   * @param bytes[IN] the memory in bytes. 0 disables the tier
+   */
+  static void setCompressedSize(size_t bytes);
+
+  /**
+   * @return the memory of the compressed tier of a shared pool
+   */
+  static size_t getCompressedSize();
+
+  /**
+   * @return the total # of allocate() misses served by the compressed tier
+   */
+  static long long getCompressedHitCount() { return compressedHitCount.load(); }
+
+  /**
+   * set the longest run of consecutive dirty pages of a file that a
+   * flush writes with a single (vectored) I/O.
+   * @param pages[IN] # pages, at most MAX_WRITE_RUN. 1 writes every page
+   *                  by itself
+   */
+  static void setWriteRun(int pages);
+
+  /**
+   * @return the longest run of pages written by a single I/O
+   */
+  static int getWriteRun() { return writeRun.load(); }
+
+  /**
+   * start, change or stop the background writer. every round, it writes
+   * the dirty pages of each shared pool that were used the longest time
+   * ago (up to 1/FLUSH_SHARE of the frames), so that allocate() seldom has
+   * to write a dirty victim before reusing its frame. pinned pages are
+   * left alone.
+   * @param msecs[IN] the time between two rounds. 0 stops writing
+   */
+  static void setWriterInterval(int msecs);
+
+  /**
+   * @return the time between two rounds of the background writer in msecs
+   */
+  static int getWriterInterval();
+
+  /**
+   * set how often the background writer runs the checkpoints registered
+   * with addCheckpoint().
+   * @param msecs[IN] the time between two checkpoints. 0 stops them
+   */
+  static void setCheckpointInterval(int msecs);
+
+  /**
+   * @return the time between two checkpoints in msecs
+   */
+  static int getCheckpointInterval();
+
+  /**
+   * register a checkpoint, called on the background writer thread
+   * (concurrently with the other threads) every checkpoint interval.
+   * @param checkpoint[IN] the function to call
+   * @param arg[IN] the argument of the function, which identifies it
+   */
+  static void addCheckpoint(void (*checkpoint)(void*), void* arg);
+
+  /**
+   * unregister a checkpoint, waiting for it to return if it is running.
+   * @param arg[IN] the argument given to addCheckpoint()
+   */
+  static void removeCheckpoint(void* arg);
+
+  /**
+   * @return the total # of pages written by the background writer
+   */
+  static long long getWriterPageCount() { return writerPageCount.load(); }
+
+  /**
+   * @return the kind of memory backing the frames: "hugetlb" (explicit
+   *         huge pages), "thp" (transparent huge pages), or "heap"
+   */
+  const char* getMemoryKind() const;
+
+  /**
+   * @return the total # of allocate() calls that found the page cached
+   */
+  static long long getHitCount()  { return hitCount.load(); }
+
+  /**
+   * @return the total # of allocate() calls that had to assign a frame
+   */
+  static long long getMissCount() { return missCount.load(); }
+
+ private:
+  // the state word of a frame: the pin count in the low bits, the flags
+  // below, and a version in the high bits that is incremented whenever
+  // the frame gets another page (or none). file, pid and hashNext only
+  // change after the version, so a successful compare-and-swap of the
+  // state word read before them proves that they were not changed.
+  static const uint64_t PIN_MASK   = 0xffffff;   // # pins on the frame
+  static const uint64_t LOADING    = 1 << 24;    // the content is being
+                                                 //   filled in
+  static const uint64_t UNLISTED   = 1 << 25;    // not a candidate of the
+                                                 //   policy until unpinned
+  static const uint64_t REFERENCED = 1 << 26;    // pinned without the latch
+                                                 //   since it became one
+  static const uint64_t VERSION    = 1ULL << 32; // one version
+
+  // # counters of the pinned frames, each in its own cache line
+  static const int PIN_STRIPES = 16;
+
+  struct Frame {
+    std::atomic<const PageFile*> file;  // the file of the cached page.
+                                        //   NULL if free
+    std::atomic<PageId> pid;   // the page id of the cached page
+    char*  data;               // the page content
+    std::atomic<int> hashNext; // next frame in the same hash bucket
+    std::atomic<uint64_t> state; // pin count, flags and version (see above)
+    bool   dirty;          // true if the frame must be written back
+    long long lsn;         // the log record of the last change. 0 if none
+    std::atomic<int> uses; // # lookups of the page since it was cached
+    std::atomic<long long> lastUse; // the value of useClock at the last
+                                    //   lookup
+    const PageFile* evictedFile; // the page evicted from the frame that
+    PageId evictedPid;           //   is still to be compressed (see
+    long long evictedTicket;     //   stash()). evictedFile is NULL if none
+  };
+
+  int    pageSize;    // the size of a frame
+  int    frameCount;  // the number of frames
+  Frame* frames;      // the frames
+  char*  memory;      // the memory backing all frames
+  size_t memorySize;  // the size of the mapping if memory is mapped
+  int    memoryKind;  // how memory was obtained (HEAP, HUGETLB, THP)
+  std::atomic<int>* buckets; // the first frame of each hash bucket.
+                             //   -1 if empty
+  int    bucketMask;  // (# buckets - 1). # buckets is a power of two
+  struct {
+    std::atomic<int> count;  // # pinned frames f with f % PIN_STRIPES == i
+    char pad[64 - sizeof(std::atomic<int>)];
+  } pinnedCounts[PIN_STRIPES];  // (see getPinnedCount())
+  std::atomic<long long> useClock; // # latched lookups so far, to order
+                                   //   the lookups (see touch())
+  std::vector<int> freeFrames;  // the frames that hold no page
+  ReplacementPolicy* policy;    // chooses the frame to evict
+  CompressedCache tier;         // keeps evicted pages compressed
+
+  std::mutex latch;                // protects all of the above, except
+                                   //   what the state words of the
+                                   //   frames protect (see Frame)
+  std::condition_variable loaded;  // signaled when a frame is ready
+
+  BufferPool(const BufferPool&);
+  BufferPool& operator=(const BufferPool&);
+
+  enum { HEAP, HUGETLB, THP };
+
+  // pages to write: ((file, pid), frame), sorted by (file, pid)
+  typedef std::vector<std::pair<std::pair<const PageFile*, PageId>, int> > WriteList;
+
+  void init(int frameCount);
+  bool allocateHuge(size_t size);
+  void release();
+  void setReplacement(const std::string& name);
+
+  static uint64_t keyOf(const PageFile* file, PageId pid);
+  static uint64_t pageKeyOf(const PageFile* file, PageId pid);
+  int  bucketOf(const PageFile* file, PageId pid) const;
+  RC   flush(std::unique_lock<std::mutex>& lock, const std::vector<int>& list);
+  RC   writeRuns(std::unique_lock<std::mutex>& lock, const WriteList& order);
+  int  find(const PageFile* file, PageId pid) const;
+  int  tryPin(const PageFile* file, PageId pid);
+  bool tryUnpin(const PageFile* file, PageId pid);
+  void countPinned(int f, int delta);
+  int  getPinnedCount() const;
+  void relist(int f);
+  int  claimVictim();
+  int  findReady(std::unique_lock<std::mutex>& lock, const PageFile* file, PageId pid);
+  int  assign(const PageFile* file, PageId pid, bool referenced, RC& rc);
+  void stash(std::unique_lock<std::mutex>& lock, int f);
+  bool fillFromTier(std::unique_lock<std::mutex>& lock, int f);
+  void writeOldest();
+  void pinFrame(int f);
+  void touch(int f);
+  void unpinFrame(int f);
+  void drop(int f);
+  void unhash(int f);
+
+  static std::atomic<BufferPool*> pools[POOL_COUNT]; // the shared pools
+  static int poolSize;      // the number of frames of a shared pool
+  static std::string policyName;    // the replacement policy of the pools
+  static bool hugePages;            // true if the pools use huge pages
+  static size_t compressedSize;     // the memory of a compressed tier
+  static std::mutex poolLatch;      // protects the creation of the pools
+                                    //   and the four above
+  static std::atomic<long long> hitCount;  // total # of allocate() hits
+  static std::atomic<long long> missCount; // total # of allocate() misses
+  static std::atomic<long long> compressedHitCount; // # misses served by
+                                                    //   the compressed tiers
+  static std::atomic<int> writeRun; // the longest run written by one I/O
+  static std::atomic<long long> writerPageCount; // # pages written by
+                                                 //   the background writer
+  static thread_local const Frame* lastPinned; // the frame this thread
+                                               //   pinned last, whose
+                                               //   pins count once
+
+  static void runWriter();
+
+  static int poolIndex(int pageSize);
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,80 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#include <cstring>
+#include "Checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define HAVE_SSE42_CRC32 1
+#endif
+
+static const uint32_t CRC32C_POLY = 0x82f63b78;  // reflected polynomial
+
+static uint32_t table[256];
+
+static bool initTable()
+{
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+    table[i] = c;
+  }
+  return true;
+}
+
+static uint32_t crc32cSoftware(uint32_t crc, const unsigned char* p, size_t len)
+{
+  static bool ready = initTable();
+  (void)ready;
+
+  while (len-- > 0) crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#ifdef HAVE_SSE42_CRC32
+__attribute__((target("sse4.2")))
+static uint32_t crc32cSse42(uint32_t crc, const unsigned char* p, size_t len)
+{
+#if defined(__x86_64__)
+  uint64_t c = crc;
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    c = _mm_crc32_u64(c, v);
+  }
+  crc = (uint32_t)c;
+#endif
+  for (; len >= 4; p += 4, len -= 4) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    crc = _mm_crc32_u32(crc, v);
+  }
+  while (len-- > 0) crc = _mm_crc32_u8(crc, *p++);
+  return crc;
+}
+#endif
+
+bool crc32cHardware()
+{
+#ifdef HAVE_SSE42_CRC32
+  static bool sse42 = __builtin_cpu_supports("sse4.2");
+  return sse42;
+#else
+  return false;
+#endif
+}
+
+uint32_t crc32c(const void* data, size_t len)
+{
+  const unsigned char* p = (const unsigned char*)data;
+
+#ifdef HAVE_SSE42_CRC32
+  if (crc32cHardware()) return ~crc32cSse42(~0U, p, len);
+#endif
+  return ~crc32cSoftware(~0U, p, len);
+}
@@ -0,0 +1,29 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * compute the CRC32C (Castagnoli) checksum of a memory buffer.
+ * the SSE4.2 crc32 instruction is used when the CPU has it, and a
+ * table-driven implementation otherwise.
+ * @param data[IN] the buffer
+ * @param len[IN] # bytes in the buffer
+ * @return the checksum
+ */
+uint32_t crc32c(const void* data, size_t len);
+
+/**
+ * @return true if crc32c() uses the SSE4.2 instruction
+ */
+bool crc32cHardware();
+
+#endif // CHECKSUM_H
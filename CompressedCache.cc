@@ -0,0 +1,120 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#include "CompressedCache.h"
+#include "Compression.h"
+
+CompressedCache::CompressedCache(int pageSize, size_t capacity)
+  : pageSize(pageSize), capacity(capacity), size(0), tickets(0)
+{
+}
+
+CompressedCache::~CompressedCache()
+{
+  setCapacity(0);
+}
+
+void CompressedCache::setCapacity(size_t capacity)
+{
+  this->capacity = capacity;
+  shrink();
+}
+
+CompressedCache::EntryList::iterator CompressedCache::find(const PageFile* file, PageId pid)
+{
+  std::map<const PageFile*, PageMap>::iterator fit = files.find(file);
+  if (fit == files.end()) return entries.end();
+  PageMap::iterator pit = fit->second.find(pid);
+  return (pit == fit->second.end()) ? entries.end() : pit->second;
+}
+
+void CompressedCache::remove(EntryList::iterator it)
+{
+  std::map<const PageFile*, PageMap>::iterator fit = files.find(it->file);
+  fit->second.erase(it->pid);
+  if (fit->second.empty()) files.erase(fit);
+
+  size -= it->data.size() + ENTRY_OVERHEAD;
+  entries.erase(it);
+}
+
+void CompressedCache::shrink()
+{
+  // drop the oldest pages
+  while (size > capacity) remove(--entries.end());
+}
+
+long long CompressedCache::reserve(const PageFile* file, PageId pid)
+{
+  if (capacity == 0) return 0;
+
+  drop(file, pid);
+  entries.push_front(Entry());
+  entries.front().file = file;
+  entries.front().pid = pid;
+  entries.front().ticket = ++tickets;
+  files[file][pid] = entries.begin();
+  size += ENTRY_OVERHEAD;
+  shrink();
+  return tickets;
+}
+
+void CompressedCache::compress(const char* page, std::vector<char>& data) const
+{
+  // a page that does not get smaller is not worth keeping here
+  data.resize(pageSize);
+  int length = lzCompress(page, pageSize, &data[0], pageSize - ENTRY_OVERHEAD);
+  data.resize((length > 0) ? length : 0);
+}
+
+void CompressedCache::fill(const PageFile* file, PageId pid, long long ticket, std::vector<char>& data)
+{
+  // the page may have been loaded (and even evicted again) meanwhile
+  EntryList::iterator it = find(file, pid);
+  if (it == entries.end() || it->ticket != ticket) return;
+
+  if (data.empty()) {
+    remove(it);
+    return;
+  }
+  it->data.swap(data);
+  size += it->data.size();
+  shrink();
+}
+
+bool CompressedCache::take(const PageFile* file, PageId pid, std::vector<char>& data)
+{
+  EntryList::iterator it = find(file, pid);
+  if (it == entries.end()) return false;
+
+  // the data moves to the caller, so remove() only accounts for the entry
+  data.swap(it->data);
+  size -= data.size();
+  remove(it);
+
+  // a page still being compressed is not here yet
+  return !data.empty();
+}
+
+bool CompressedCache::decompress(const std::vector<char>& data, char* page) const
+{
+  return lzDecompress(&data[0], (int)data.size(), page, pageSize) == pageSize;
+}
+
+void CompressedCache::drop(const PageFile* file, PageId pid)
+{
+  EntryList::iterator it = find(file, pid);
+  if (it != entries.end()) remove(it);
+}
+
+void CompressedCache::dropFile(const PageFile* file)
+{
+  std::map<const PageFile*, PageMap>::iterator fit;
+
+  // remove() erases the map of the file along with its last page
+  while ((fit = files.find(file)) != files.end()) remove(fit->second.begin()->second);
+}
@@ -0,0 +1,143 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#ifndef COMPRESSEDCACHE_H
+#define COMPRESSEDCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include "PageFile.h"
+
+/**
+ * the second tier of a BufferPool: pages evicted from the pool are kept
+ * here compressed (see Compression.h), so that a later miss on them is
+ * served by decompressing instead of reading from the disk. B+tree nodes
+ * and record pages are mostly zero padding and shrink several times.
+ * a page is either in the pool or here, never in both: take() removes
+ * the page it returns, which the pool decompresses into a frame.
+ * pages that do not compress are not kept.
+ * when the compressed pages (and ENTRY_OVERHEAD bytes for each) take
+ * more than the capacity, the least recently stored ones are dropped.
+ * the class is not thread-safe; the pool calls it under its latch.
+ */
+class CompressedCache {
+ public:
+  static const int ENTRY_OVERHEAD = 64; // the memory used to track a page
+
+  /**
+   * @param pageSize[IN] the size of a page
+   * @param capacity[IN] the memory in bytes for the compressed pages.
+   *                     0 disables the cache
+   */
+  CompressedCache(int pageSize, size_t capacity);
+  ~CompressedCache();
+
+  /**
+   * change the memory for the compressed pages, dropping pages if needed.
+   * @param capacity[IN] the memory in bytes. 0 drops every page
+   */
+  void setCapacity(size_t capacity);
+
+  /**
+   * @return the memory in bytes for the compressed pages
+   */
+  size_t getCapacity() const { return capacity; }
+
+  /**
+   * @return the memory in bytes used by the compressed pages
+   */
+  size_t getSize() const { return size; }
+
+  /**
+   * make room for a page that is about to be compressed: any old copy of
+   * the page is dropped, and the page is kept once fill() is called.
+   * a take() or drop() of the page in the meantime cancels it.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page
+   * @return the ticket to give to fill(). 0 if the cache is disabled
+   */
+  long long reserve(const PageFile* file, PageId pid);
+
+  /**
+   * compress a (clean) page. this may be called without the latch of
+   * the pool.
+   * @param page[IN] the content of the page (pageSize bytes)
+   * @param data[OUT] the compressed page. empty if the page does not
+   *                  get smaller
+   */
+  void compress(const char* page, std::vector<char>& data) const;
+
+  /**
+   * keep a page reserved by reserve(), unless it was cancelled.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page
+   * @param ticket[IN] the ticket returned by reserve()
+   * @param data[IN/OUT] the page compressed by compress(). it is taken
+   *                     over (and left empty)
+   */
+  void fill(const PageFile* file, PageId pid, long long ticket, std::vector<char>& data);
+
+  /**
+   * take a page out of the cache, still compressed (see decompress()).
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page
+   * @param data[OUT] the compressed page
+   * @return true if the page was in the cache
+   */
+  bool take(const PageFile* file, PageId pid, std::vector<char>& data);
+
+  /**
+   * decompress a page obtained by take(). this may be called without
+   * the latch of the pool.
+   * @param data[IN] the compressed page
+   * @param page[OUT] the content of the page (pageSize bytes)
+   * @return true if the page was decompressed, false if data is corrupt
+   */
+  bool decompress(const std::vector<char>& data, char* page) const;
+
+  /**
+   * drop a page from the cache, e.g., because it was written to the disk.
+   * @param file[IN] the file the page belongs to
+   * @param pid[IN] the page
+   */
+  void drop(const PageFile* file, PageId pid);
+
+  /**
+   * drop every page of a file from the cache.
+   * @param file[IN] the file
+   */
+  void dropFile(const PageFile* file);
+
+ private:
+  struct Entry {
+    const PageFile* file;   // the file of the page
+    PageId pid;             // the page
+    std::vector<char> data; // the compressed page. empty while reserved
+    long long ticket;       // the reservation of the page
+  };
+  typedef std::list<Entry> EntryList;
+  typedef std::unordered_map<PageId, EntryList::iterator> PageMap;
+
+  int    pageSize;  // the size of a page
+  size_t capacity;  // the memory for the compressed pages
+  size_t size;      // the memory used by the compressed pages
+  long long tickets;  // # reservations so far
+  EntryList entries;  // the pages, the most recently stored first
+  std::map<const PageFile*, PageMap> files; // the pages of each file
+
+  CompressedCache(const CompressedCache&);
+  CompressedCache& operator=(const CompressedCache&);
+
+  EntryList::iterator find(const PageFile* file, PageId pid);
+  void remove(EntryList::iterator it);
+  void shrink();
+};
+
+#endif // COMPRESSEDCACHE_H
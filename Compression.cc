@@ -0,0 +1,153 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#include <cstring>
+#include <stdint.h>
+#include "Compression.h"
+
+static const int MIN_MATCH = 4;     // the shortest match worth encoding
+static const int MAX_OFFSET = 65535;
+static const int HASH_BITS = 11;    // the size of the match finder table
+
+static inline uint32_t read32(const unsigned char* p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline int hashOf(uint32_t v)
+{
+  return (int)((v * 2654435761u) >> (32 - HASH_BITS));
+}
+
+// write the extra bytes of a length of 15 or more (see Compression.h)
+static unsigned char* putLength(unsigned char* op, int len)
+{
+  for (len -= 15; len >= 255; len -= 255) *op++ = 255;
+  *op++ = (unsigned char)len;
+  return op;
+}
+
+// write a sequence of litLen literals and a match of matchLen bytes at
+// offset back (no match if matchLen is 0). return NULL if it does not fit.
+static unsigned char* putSequence(unsigned char* op, unsigned char* oend,
+                                  const unsigned char* lit, int litLen,
+                                  int offset, int matchLen)
+{
+  int m = (matchLen > 0) ? matchLen - MIN_MATCH : 0;
+
+  // the worst case: token, literals, offset and both lengths
+  if ((oend - op) < 1 + litLen + litLen / 255 + 1 + 2 + m / 255 + 1) return NULL;
+
+  *op++ = (unsigned char)(((litLen < 15) ? litLen : 15) << 4 | ((m < 15) ? m : 15));
+  if (litLen >= 15) op = putLength(op, litLen);
+  if (litLen > 0) memcpy(op, lit, litLen);
+  op += litLen;
+
+  if (matchLen > 0) {
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    if (m >= 15) op = putLength(op, m);
+  }
+  return op;
+}
+
+int lzCompress(const char* source, int size, char* dest, int capacity)
+{
+  const unsigned char* src = (const unsigned char*)source;
+  const unsigned char* ip = src;        // the next byte to encode
+  const unsigned char* anchor = src;    // the first byte not yet written
+  const unsigned char* iend = src + size;
+  unsigned char* op = (unsigned char*)dest;
+  unsigned char* oend = op + capacity;
+  uint16_t table[1 << HASH_BITS];       // (position + 1) of a 4-byte prefix
+
+  if (size < 0 || size > LZ_MAX_INPUT) return -1;
+  memset(table, 0, sizeof(table));
+
+  // look up every position's 4-byte prefix in the table of the last
+  // position where it was seen, and extend the matches found
+  while (iend - ip >= MIN_MATCH) {
+    uint32_t v = read32(ip);
+    int h = hashOf(v);
+    int last = table[h];
+    table[h] = (uint16_t)(ip - src + 1);
+
+    const unsigned char* ref = src + (last > 0 ? last - 1 : 0);
+    if (last == 0 || ip - ref > MAX_OFFSET || read32(ref) != v) {
+      ip++;
+      continue;
+    }
+
+    // the match may overlap the bytes it copies (e.g., a run of zeros)
+    const unsigned char* mp = ip + MIN_MATCH;
+    ref += MIN_MATCH;
+    while (mp < iend && *mp == *ref) {
+      mp++;
+      ref++;
+    }
+
+    op = putSequence(op, oend, anchor, (int)(ip - anchor), (int)(mp - ref), (int)(mp - ip));
+    if (op == NULL) return -1;
+    ip = anchor = mp;
+  }
+
+  // the bytes after the last match
+  op = putSequence(op, oend, anchor, (int)(iend - anchor), 0, 0);
+  if (op == NULL) return -1;
+
+  return (int)(op - (unsigned char*)dest);
+}
+
+int lzDecompress(const char* source, int size, char* dest, int capacity)
+{
+  const unsigned char* ip = (const unsigned char*)source;
+  const unsigned char* iend = ip + size;
+  unsigned char* op = (unsigned char*)dest;
+  unsigned char* oend = op + capacity;
+  int token, len, b, offset;
+
+  while (ip < iend) {
+    token = *ip++;
+
+    // the literals
+    len = token >> 4;
+    if (len == 15) {
+      do {
+        if (ip >= iend) return -1;
+        len += (b = *ip++);
+      } while (b == 255);
+    }
+    if (len > iend - ip || len > oend - op) return -1;
+    if (len > 0) memcpy(op, ip, len);
+    op += len;
+    ip += len;
+
+    // the last sequence has no match
+    if (ip == iend) break;
+
+    // the match, copied one byte at a time since it may overlap itself
+    if (iend - ip < 2) return -1;
+    offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > op - (unsigned char*)dest) return -1;
+    len = token & 15;
+    if (len == 15) {
+      do {
+        if (ip >= iend) return -1;
+        len += (b = *ip++);
+      } while (b == 255);
+    }
+    len += MIN_MATCH;
+    if (len > oend - op) return -1;
+    const unsigned char* ref = op - offset;
+    while (len-- > 0) *op++ = *ref++;
+  }
+
+  return (int)(op - (unsigned char*)dest);
+}
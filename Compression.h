@@ -0,0 +1,46 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+/**
+ * a fast byte-oriented LZ77 codec in the style of LZ4, for compressing
+ * pages in memory. the compressed data is a series of sequences, each a
+ * token byte (# literals in the high 4 bits, match length - 4 in the low
+ * 4 bits; 15 means that bytes of up to 255 follow to add to it), the
+ * literals, and the match as a 2-byte little-endian offset back into the
+ * output. the last sequence has only literals.
+ * runs of the same byte (e.g., the zero padding of a page) become a
+ * single match, so a mostly empty page compresses to a few bytes.
+ */
+
+// the largest buffer lzCompress() accepts, so that offsets fit in 2 bytes
+static const int LZ_MAX_INPUT = 65535;
+
+/**
+ * compress a buffer.
+ * @param src[IN] the buffer
+ * @param size[IN] # bytes in the buffer. at most LZ_MAX_INPUT
+ * @param dst[OUT] the compressed data
+ * @param capacity[IN] # bytes available in dst
+ * @return # bytes of compressed data. -1 if it does not fit in capacity
+ */
+int lzCompress(const char* src, int size, char* dst, int capacity);
+
+/**
+ * decompress data produced by lzCompress().
+ * @param src[IN] the compressed data
+ * @param size[IN] # bytes of compressed data
+ * @param dst[OUT] the decompressed buffer
+ * @param capacity[IN] # bytes available in dst
+ * @return # bytes of the decompressed buffer. -1 if the data is corrupt
+ *         or does not fit in capacity
+ */
+int lzDecompress(const char* src, int size, char* dst, int capacity);
+
+#endif // COMPRESSION_H
@@ -0,0 +1,159 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#include <cstdio>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include "IOStats.h"
+
+using std::string;
+using std::vector;
+using std::pair;
+
+static std::mutex registryLatch;              // protects the three below
+static std::map<string, IOStats*> fileStats;  // the statistics by file name
+static vector<pair<string, IOStats*> > threadStats; // in order of creation
+static int unnamedThreads = 0;                // # threads called "thread N"
+
+static thread_local IOStats* myStats = NULL;  // the calling thread's entry
+static thread_local int myIndex = -1;         //   and its index
+
+IOStats::IOStats()
+  : reads(0), writes(0), hits(0), misses(0), tierHits(0), evictions(0),
+    writeCalls(0), writeBytes(0)
+{
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    readLatency[i] = 0;
+    writeLatency[i] = 0;
+  }
+}
+
+IOStats* IOStats::forFile(const string& name)
+{
+  std::unique_lock<std::mutex> lock(registryLatch);
+  IOStats*& stats = fileStats[name];
+  if (stats == NULL) stats = new IOStats;
+  return stats;
+}
+
+// register the statistics of the calling thread under a name
+static IOStats* registerThread(const string& name)
+{
+  myStats = new IOStats;
+  myIndex = (int)threadStats.size();
+  threadStats.push_back(std::make_pair(name, myStats));
+  return myStats;
+}
+
+IOStats* IOStats::forThread()
+{
+  if (myStats != NULL) return myStats;
+
+  std::unique_lock<std::mutex> lock(registryLatch);
+  char name[32];
+  snprintf(name, sizeof(name), "thread %d", ++unnamedThreads);
+  return registerThread(name);
+}
+
+void IOStats::nameThread(const string& name)
+{
+  std::unique_lock<std::mutex> lock(registryLatch);
+
+  // a thread named before its first I/O takes no number
+  if (myStats == NULL) registerThread(name);
+  else threadStats[myIndex].first = name;
+}
+
+void IOStats::list(vector<pair<string, IOStats*> >& files,
+                   vector<pair<string, IOStats*> >& threads)
+{
+  std::unique_lock<std::mutex> lock(registryLatch);
+  files.assign(fileStats.begin(), fileStats.end());
+  threads = threadStats;
+}
+
+void IOStats::countRead(IOStats* file, long long nsecs)
+{
+  int b = bucketOf(nsecs);
+  IOStats* thread = forThread();
+
+  if (file != NULL) {
+    file->reads.fetch_add(1, std::memory_order_relaxed);
+    file->readLatency[b].fetch_add(1, std::memory_order_relaxed);
+  }
+  thread->reads.fetch_add(1, std::memory_order_relaxed);
+  thread->readLatency[b].fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::countWrite(IOStats* file, long long nsecs)
+{
+  int b = bucketOf(nsecs);
+  IOStats* thread = forThread();
+
+  if (file != NULL) {
+    file->writes.fetch_add(1, std::memory_order_relaxed);
+    file->writeLatency[b].fetch_add(1, std::memory_order_relaxed);
+  }
+  thread->writes.fetch_add(1, std::memory_order_relaxed);
+  thread->writeLatency[b].fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::countWriteCall(IOStats* file, long long bytes)
+{
+  IOStats* thread = forThread();
+
+  if (file != NULL) {
+    file->writeCalls.fetch_add(1, std::memory_order_relaxed);
+    file->writeBytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  thread->writeCalls.fetch_add(1, std::memory_order_relaxed);
+  thread->writeBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void IOStats::countHit(IOStats* file)
+{
+  if (file != NULL) file->hits.fetch_add(1, std::memory_order_relaxed);
+  forThread()->hits.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::countMiss(IOStats* file)
+{
+  if (file != NULL) file->misses.fetch_add(1, std::memory_order_relaxed);
+  forThread()->misses.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::countCompressedHit(IOStats* file)
+{
+  if (file != NULL) file->tierHits.fetch_add(1, std::memory_order_relaxed);
+  forThread()->tierHits.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IOStats::countEviction(IOStats* file)
+{
+  if (file != NULL) file->evictions.fetch_add(1, std::memory_order_relaxed);
+  forThread()->evictions.fetch_add(1, std::memory_order_relaxed);
+}
+
+long long IOStats::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int IOStats::bucketOf(long long nsecs)
+{
+  long long usecs = nsecs / 1000;
+  int b = 0;
+
+  // the bucket of n > 0 usecs is the # bits of n
+  while (usecs > 0 && b < LATENCY_BUCKETS - 1) {
+    usecs >>= 1;
+    b++;
+  }
+  return b;
+}
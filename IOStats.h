@@ -0,0 +1,98 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#ifndef IOSTATS_H
+#define IOSTATS_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+/**
+ * I/O statistics of one file or one thread: # page reads and writes,
+ * buffer pool hits, misses (and those of them served by the compressed
+ * tier) and evictions, # write I/Os and their bytes (whose ratio is the
+ * average write size), and histograms of the latency
+ * of the reads and writes. bucket 0 of a histogram counts the I/Os that
+ * took less than 1 usec, and bucket i (i > 0) those that took from
+ * 2^(i-1) up to 2^i usec. the latency of an asynchronous I/O is the time
+ * from its submission to its completion.
+ * the statistics of a file are kept by name, so they add up over every
+ * open() of the file; those of a thread are kept for the life of the
+ * process. all counters are atomic, and the objects are never deleted.
+ */
+class IOStats {
+ public:
+  static const int LATENCY_BUCKETS = 32;
+
+  std::atomic<long long> reads;      // # pages read from the disk
+  std::atomic<long long> writes;     // # pages written to the disk
+  std::atomic<long long> hits;       // # pages found in the buffer pool
+  std::atomic<long long> misses;     // # pages not found in the pool
+  std::atomic<long long> tierHits;   // # misses found in the compressed tier
+  std::atomic<long long> evictions;  // # pages evicted from the pool
+  std::atomic<long long> writeCalls; // # write I/Os (one may write many pages)
+  std::atomic<long long> writeBytes; // # bytes written by the write I/Os
+  std::atomic<long long> readLatency[LATENCY_BUCKETS];
+  std::atomic<long long> writeLatency[LATENCY_BUCKETS];
+
+  IOStats();
+
+  /**
+   * @param name[IN] the name of a file
+   * @return the statistics of the file
+   */
+  static IOStats* forFile(const std::string& name);
+
+  /**
+   * @return the statistics of the calling thread
+   */
+  static IOStats* forThread();
+
+  /**
+   * name the calling thread in the statistics. unnamed threads are
+   * called "thread N" in the order they first did I/O.
+   * @param name[IN] the name
+   */
+  static void nameThread(const std::string& name);
+
+  /**
+   * list the statistics of all files and threads seen so far.
+   * @param files[OUT] (name, statistics) of every file, sorted by name
+   * @param threads[OUT] (name, statistics) of every thread
+   */
+  static void list(std::vector<std::pair<std::string, IOStats*> >& files,
+                   std::vector<std::pair<std::string, IOStats*> >& threads);
+
+  //
+  // count an event for a file (which may be NULL) and the calling thread
+  //
+  static void countRead(IOStats* file, long long nsecs);
+  static void countWrite(IOStats* file, long long nsecs);
+  static void countWriteCall(IOStats* file, long long bytes);
+  static void countHit(IOStats* file);
+  static void countMiss(IOStats* file);
+  static void countCompressedHit(IOStats* file);
+  static void countEviction(IOStats* file);
+
+  /**
+   * @return the current time in nanoseconds, for measuring latencies
+   */
+  static long long now();
+
+  /**
+   * @param nsecs[IN] a latency in nanoseconds
+   * @return the histogram bucket of the latency
+   */
+  static int bucketOf(long long nsecs);
+
+ private:
+  IOStats(const IOStats&);
+  IOStats& operator=(const IOStats&);
+};
+
+#endif // IOSTATS_H
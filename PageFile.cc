@@ -9,30 +9,235 @@
 
 #include "Bruinbase.h"
 #include "PageFile.h"
+#include "BufferPool.h"
+#include "AsyncIO.h"
+#include "Checksum.h"
+#include "IOStats.h"
+#include "WriteAheadLog.h"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <vector>
+#include <stdint.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 using std::string;
 
-int PageFile::readCount = 0;
-int PageFile::writeCount = 0;
-int PageFile::cacheClock = 1;
-struct PageFile::cacheStruct PageFile::readCache[PageFile::CACHE_COUNT];
+std::atomic<long long> PageFile::readCount(0);
+std::atomic<long long> PageFile::writeCount(0);
+std::atomic<long long> PageFile::checksumErrors(0);
+std::atomic<int> PageFile::readaheadPages(PageFile::DEFAULT_READAHEAD);
+std::atomic<int> PageFile::growthStep(PageFile::DEFAULT_GROWTH_STEP);
+std::atomic<int> PageFile::warmupPages(0);
+const char* const PageFile::WARMUP_SUFFIX = ".warm";
+std::atomic<int> PageFile::createPageSize(PageFile::PAGE_SIZE);
+
+//
+// the header of a file. it is stored at the beginning of the first
+// pageSize bytes of the file, which are not part of any page.
+// files without a header (created before page sizes were configurable)
+// have pages of PAGE_SIZE bytes starting at offset 0, and are read like
+// files of version 1.
+//
+static const int HEADER_MAGIC = 0x46504242;  // "BBPF"
+static const int HEADER_VERSION = 2;         // the version of new files
+static const int OLD_HEADER_VERSION = 1;     // 4-byte page ids
+
+struct FileHeader {
+  int magic;        // HEADER_MAGIC
+  int version;      // HEADER_VERSION or OLD_HEADER_VERSION
+  int pageSize;     // the page size of the file
+  int checksum;     // 1 if the pages have checksums (see PageFile::CHECKSUM)
+  PageId freeHead;  // the first page of the free list (see saveFreeList())
+  PageId freeCount; // # pages in the free list. 0 if there is none
+  long long freeSum;// the CRC32C of the free list (see freeListSum()).
+                    //   -1 if it is not known
+};
+
+//
+// the layout of the header on the disk: the offsets of its fields.
+// version 1 stores the free list in ints. version 2 stores it in 8-byte
+// fields after them, and sets the int head to -1. the CRC of the list
+// comes last, after a flag that is 0 in older files.
+//
+enum {
+  MAGIC_AT = 0, VERSION_AT = 4, PAGE_SIZE_AT = 8, FREE_HEAD_AT = 12,
+  FREE_COUNT_AT = 16, CHECKSUM_AT = 20, FREE_HEAD_LONG_AT = 24,
+  FREE_COUNT_LONG_AT = 32, FREE_SUMMED_AT = 40, FREE_SUM_AT = 44,
+  HEADER_SIZE = 48
+};
+
+template<class T> static T loadField(const char* block, int at)
+{
+  T value;
+  memcpy(&value, block + at, sizeof(value));
+  return value;
+}
+
+template<class T> static void storeField(char* block, int at, T value)
+{
+  memcpy(block + at, &value, sizeof(value));
+}
+
+// convert the header from its layout on the disk
+static void loadHeader(const char* block, FileHeader& header)
+{
+  header.magic = loadField<int>(block, MAGIC_AT);
+  header.version = loadField<int>(block, VERSION_AT);
+  header.pageSize = loadField<int>(block, PAGE_SIZE_AT);
+  header.checksum = loadField<int>(block, CHECKSUM_AT);
+  if (header.version == OLD_HEADER_VERSION) {
+    header.freeHead = loadField<int>(block, FREE_HEAD_AT);
+    header.freeCount = loadField<int>(block, FREE_COUNT_AT);
+  } else {
+    header.freeHead = loadField<long long>(block, FREE_HEAD_LONG_AT);
+    header.freeCount = loadField<long long>(block, FREE_COUNT_LONG_AT);
+  }
+  header.freeSum = loadField<int>(block, FREE_SUMMED_AT) ? loadField<unsigned>(block, FREE_SUM_AT) : -1;
+}
+
+// convert the header to its layout on the disk (block is zero-filled)
+static void storeHeader(const FileHeader& header, char* block)
+{
+  storeField<int>(block, MAGIC_AT, header.magic);
+  storeField<int>(block, VERSION_AT, header.version);
+  storeField<int>(block, PAGE_SIZE_AT, header.pageSize);
+  storeField<int>(block, CHECKSUM_AT, header.checksum);
+  if (header.version == OLD_HEADER_VERSION) {
+    storeField<int>(block, FREE_HEAD_AT, (int)header.freeHead);
+    storeField<int>(block, FREE_COUNT_AT, (int)header.freeCount);
+  } else {
+    storeField<int>(block, FREE_HEAD_AT, -1);
+    storeField<long long>(block, FREE_HEAD_LONG_AT, header.freeHead);
+    storeField<long long>(block, FREE_COUNT_LONG_AT, header.freeCount);
+  }
+  if (header.freeCount > 0 && header.freeSum >= 0) {
+    storeField<int>(block, FREE_SUMMED_AT, 1);
+    storeField<unsigned>(block, FREE_SUM_AT, (unsigned)header.freeSum);
+  }
+}
+
+//
+// a page of the free list: the id of the next page of the list
+// (-1 at the end), # ids that follow, and the ids, each stored like
+// a page id (see PageFile::storePid()). the pages of the list are free
+// pages themselves.
+//
+static const int FREE_LIST_HEADER = 2;  // # fields before the ids
+
+//
+// the checksum of a free list: the CRC32C of all its pages (the pages
+// of the list included) in ascending order, each stored as a PageId.
+//
+static uint32_t freeListSum(const std::set<PageId>& pids)
+{
+  std::vector<PageId> sorted(pids.begin(), pids.end());
+  return sorted.empty() ? 0 : crc32c(&sorted[0], sorted.size() * sizeof(PageId));
+}
+
+//
+// the warm-up list of a file (see PageFile::WARMUP_SUFFIX): this header
+// followed by the page ids, hottest first.
+//
+static const int WARMUP_MAGIC = 0x4C574242;  // "BBWL"
+
+struct WarmupHeader {
+  int magic;  // WARMUP_MAGIC
+  int count;  // # page ids that follow
+};
+
+// the warm-up lists of the process. the lists are only written when the
+// process shuts down, with the hottest pages of the last close() of each
+// file. only the first open() of a file in the process follows a
+// restart; later ones find what the process left, and do not warm up.
+struct WarmupLists {
+  std::mutex latch;                              // protects the two below
+  std::set<string> read;                         // the lists read so far
+  std::map<string, std::vector<PageId> > latest; // the lists to write
+};
+
+static WarmupLists warmupLists;
+
+void PageFile::saveWarmupLists()
+{
+  std::map<string, std::vector<PageId> >::const_iterator it;
+  WarmupHeader header;
+  std::unique_lock<std::mutex> lock(warmupLists.latch);
+  const std::map<string, std::vector<PageId> >& latest = warmupLists.latest;
+
+  for (it = latest.begin(); it != latest.end(); ++it) {
+    const std::vector<PageId>& pids = it->second;
+    string tmpName = it->first + ".XXXXXX";
+    int wfd;
+
+    // write the new list aside and then rename it over the old one, so
+    // that a crash (or another process) leaves a whole list
+    if ((wfd = ::mkstemp(&tmpName[0])) < 0) continue;
+    header.magic = WARMUP_MAGIC;
+    header.count = (int)pids.size();
+    size_t size = pids.size() * sizeof(PageId);
+    bool ok = ::write(wfd, &header, sizeof(header)) == sizeof(header)
+      && ::write(wfd, &pids[0], size) == (ssize_t)size;
+    if (::close(wfd) < 0) ok = false;
+    if (!ok || ::rename(tmpName.c_str(), it->first.c_str()) < 0) ::unlink(tmpName.c_str());
+  }
+  warmupLists.latest.clear();
+}
 
 PageFile::PageFile() 
 { 
-  fd = -1; 
-  epid = 0; 
+  reset();
 }
 
-PageFile::PageFile(const string& filename, char mode)
+PageFile::PageFile(const string& filename, char mode, int flags)
 {
+  reset();
+  open(filename.c_str(), mode, flags);
+}
+
+void PageFile::reset()
+{
+  // the state of a PageFile that has no file open
   fd = -1;
   epid = 0;
-  open(filename.c_str(), mode);
+  flags = 0;
+  writable = false;
+  pageSize = PAGE_SIZE;
+  dataSize = PAGE_SIZE;
+  checksums = false;
+  version = OLD_HEADER_VERSION;
+  pidSize = sizeof(int);
+  base = 0;
+  map = NULL;
+  mapSize = 0;
+  stats = NULL;
+  warmName.clear();
+  name.clear();
+  fileId = 0;
+  freePages.clear();
+  freeChanged = false;
+  freeHead = -1;
+  freeCount = 0;
+  freeSum = -1;
+  nextPid = -1;
+  seqCount = 0;
+  raEnd = 0;
+  allocEnd = 0;
+  prefetching = 0;
+}
+
+PageFile::~PageFile()
+{
+  // the buffer pool must not keep (dirty) pages of a file that is gone
+  if (fd >= 0) close();
 }
 
-RC PageFile::open(const string& filename, char mode)
+RC PageFile::open(const string& filename, char mode, int flags)
 {
   RC   rc;
   int  oflag;
@@ -57,34 +262,331 @@ RC PageFile::open(const string& filename, char mode)
   // open the file
   fd = ::open(filename.c_str(), oflag, 0644);
   if (fd < 0) { fd = -1; return RC_FILE_OPEN_FAILED; }
+  stats = IOStats::forFile(filename);
 
   // get the size of the file to set the end pid
   rc = ::fstat(fd, &statbuf);
   if (rc < 0) { ::close(fd); fd = -1; return RC_FILE_OPEN_FAILED; }
-  epid = statbuf.st_size / PAGE_SIZE;
+  fileId = ((uint64_t)statbuf.st_dev << 32) ^ (uint64_t)statbuf.st_ino;
+
+  // find the page size in the header, or write the header of a new file
+  writable = (oflag != O_RDONLY);
+  if ((rc = readHeader(statbuf.st_size)) < 0) {
+    ::close(fd);
+    fd = -1;
+    return rc;
+  }
+  if (statbuf.st_size == 0 && writable) {
+    pageSize = createPageSize;
+    base = pageSize;
+    version = HEADER_VERSION;
+    pidSize = sizeof(PageId);
+    checksums = (flags & CHECKSUM) != 0;
+    dataSize = checksums ? pageSize - CHECKSUM_SIZE : pageSize;
+    if ((rc = writeHeader()) < 0) {
+      ::close(fd);
+      fd = -1;
+      return rc;
+    }
+  }
+  epid = (statbuf.st_size > base) ? (statbuf.st_size - base) / pageSize : 0;
+  allocEnd = epid.load();
+
+  // read the list of free pages
+  if ((rc = loadFreeList()) < 0) {
+    ::close(fd);
+    fd = -1;
+    return rc;
+  }
+
+  // map a read-only file into memory if requested.
+  // if the mapping fails, the file is accessed through the buffer pool.
+  if ((flags & MMAP) && oflag == O_RDONLY && epid > 0) {
+    mapSize = (size_t)offset(epid);
+    map = (char*)::mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+      map = NULL;
+      mapSize = 0;
+    }
+  }
+  if (map == NULL) flags &= ~MMAP;
+
+  // bypass the OS page cache if requested (and the file is not mapped).
+  // if the file system does not support direct I/O, or not with the
+  // alignment of our frames, the file is accessed with buffered I/O.
+  if (map != NULL || !(flags & DIRECT) || !enableDirect()) flags &= ~DIRECT;
+  if (checksums) flags |= CHECKSUM;
+  else flags &= ~CHECKSUM;
+  if (!writable || map != NULL) flags &= ~PREALLOCATE;
+  if (!writable || map != NULL || ((flags & LOGGED) && !WriteAheadLog::opened())) flags &= ~LOGGED;
+
+  // the pages of a logged file are written back, so that a write costs an
+  // append to the log instead of a sync of the log
+  if (flags & LOGGED) flags |= WRITE_BACK;
+  this->flags = flags;
+  name = filename;
+
+  // start reading the pages that were hot when the file was last closed
+  warmName = filename + WARMUP_SUFFIX;
+  if (warmupPages > 0 && map == NULL) warmUp();
 
   return 0;
 }
 
+RC PageFile::readHeader(off_t size)
+{
+  char block[HEADER_SIZE];
+  FileHeader header;
+
+  pageSize = PAGE_SIZE;
+  dataSize = PAGE_SIZE;
+  checksums = false;
+  version = OLD_HEADER_VERSION;
+  pidSize = sizeof(int);
+  base = 0;
+  freeHead = -1;
+  freeCount = 0;
+  freeSum = -1;
+  if (size < (off_t)sizeof(int) * 2) return 0;
+
+  // a header of version 1 is shorter; the fields it does not have read as 0
+  memset(block, 0, sizeof(block));
+  if (::pread(fd, block, sizeof(block), 0) < (ssize_t)sizeof(int) * 2) return RC_FILE_READ_FAILED;
+  loadHeader(block, header);
+  if (header.magic != HEADER_MAGIC) return 0;  // a file without a header
+
+  if ((header.version != HEADER_VERSION && header.version != OLD_HEADER_VERSION) ||
+      !isValidPageSize(header.pageSize)) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+  pageSize = header.pageSize;
+  base = pageSize;
+  version = header.version;
+  if (version != OLD_HEADER_VERSION) pidSize = sizeof(PageId);
+  freeHead = header.freeHead;
+  freeCount = header.freeCount;
+  freeSum = header.freeSum;
+  checksums = (header.checksum != 0);
+  dataSize = checksums ? pageSize - CHECKSUM_SIZE : pageSize;
+  return 0;
+}
+
+RC PageFile::writeHeader()
+{
+  void* block;
+  FileHeader header;
+  ssize_t n;
+
+  // a file keeps its version; the page ids of version 1 fit in an int
+  header.magic = HEADER_MAGIC;
+  header.version = version;
+  header.pageSize = pageSize;
+  header.checksum = checksums ? 1 : 0;
+  header.freeHead = freeHead;
+  header.freeCount = freeCount;
+  header.freeSum = freeSum;
+
+  // the header takes a whole page so that the pages stay aligned
+  // (and the buffer is aligned for direct I/O)
+  if (posix_memalign(&block, pageSize, pageSize) != 0) return RC_FILE_WRITE_FAILED;
+  memset(block, 0, pageSize);
+  storeHeader(header, (char*)block);
+  n = ::pwrite(fd, block, pageSize, 0);
+  free(block);
+  if (n != pageSize) return RC_FILE_WRITE_FAILED;
+
+  return 0;
+}
+
+RC PageFile::loadFreeList()
+{
+  std::vector<long long> block(pageSize / sizeof(long long));
+  const char* page = (const char*)&block[0];
+  PageId pid = freeHead;
+  PageId n;
+  bool   valid = true;
+
+  freePages.clear();
+  freeChanged = false;
+
+  // follow the chain of list pages. a list that is damaged in any way
+  // (a page out of range or listed twice, a checksum or a count that
+  // does not match) is discarded: this only loses free pages, whereas
+  // a page that is not free would be overwritten once reused.
+  while (valid && pid >= 0) {
+    if (pid >= epid || !freePages.insert(pid).second) {
+      valid = false;
+      break;
+    }
+    if (::pread(fd, &block[0], pageSize, offset(pid)) != pageSize) return RC_FILE_READ_FAILED;
+    if (!verify(page)) {
+      checksumErrors++;
+      valid = false;
+      break;
+    }
+    n = loadPid(page + pidSize);
+    if (n < 0 || n > dataSize / pidSize - FREE_LIST_HEADER) {
+      valid = false;
+      break;
+    }
+    for (int i = 0; i < n && valid; i++) {
+      PageId p = loadPid(page + (FREE_LIST_HEADER + i) * pidSize);
+      valid = (p >= 0 && p < epid && freePages.insert(p).second);
+    }
+    pid = loadPid(page);
+  }
+  if (valid && (PageId)freePages.size() != freeCount) valid = false;
+  if (valid && freeSum >= 0 && freeListSum(freePages) != (uint32_t)freeSum) valid = false;
+
+  // the header stops pointing to a discarded list when the file is closed
+  if (!valid) {
+    freePages.clear();
+    freeChanged = true;
+  }
+  return 0;
+}
+
+RC PageFile::saveFreeList()
+{
+  std::vector<PageId> pids(freePages.begin(), freePages.end());
+  PageId capacity = dataSize / pidSize - FREE_LIST_HEADER;
+  PageId n = (PageId)pids.size();
+  PageId lists, i, t;
+  long long lsn = 0;
+  RC     rc;
+
+  if (!freeChanged || !writable || base == 0) return 0;
+
+  // the list is stored in the last (highest) free pages, so that the
+  // pages reused first, the lower ones, are not needed by the list
+  for (lists = 0; n - lists > lists * capacity; lists++);
+  std::vector<long long> block((size_t)lists * pageSize / sizeof(long long));
+
+  for (t = 0, i = 0; t < lists; t++) {
+    char*  page = (char*)&block[0] + t * pageSize;
+    PageId count = 0;
+
+    storePid(page, (t + 1 < lists) ? pids[n - lists + t + 1] : -1);
+    for (; i < n - lists && count < capacity; i++) {
+      storePid(page + (FREE_LIST_HEADER + count++) * pidSize, pids[i]);
+    }
+    storePid(page + pidSize, count);
+
+    // a list page may be a freed page whose older content is in the log.
+    // it is logged as well, so that recovery does not bring that back.
+    if ((flags & LOGGED) &&
+        (rc = WriteAheadLog::logPage(name, pids[n - lists + t], pageSize, flags, page, dataSize, lsn)) < 0) {
+      return rc;
+    }
+  }
+  if (lsn > 0 && (rc = WriteAheadLog::flush(lsn)) < 0) return rc;
+
+  for (t = 0; t < lists; t++) {
+    char* page = (char*)&block[0] + t * pageSize;
+    seal(page);
+    if ((rc = writePage(pids[n - lists + t], page, true)) < 0) return rc;
+  }
+
+  // the list must be on the disk before the header that points to it
+  if (lists > 0 && ::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
+
+  freeHead = (lists > 0) ? pids[n - lists] : -1;
+  freeCount = n;
+  freeSum = freeListSum(freePages);
+  if ((rc = writeHeader()) < 0) return rc;
+
+  freeChanged = false;
+  return 0;
+}
+
+bool PageFile::enableDirect()
+{
+  int   fl = ::fcntl(fd, F_GETFL);
+  void* mem;
+  ssize_t n = -1;
+
+  if (fl < 0 || ::fcntl(fd, F_SETFL, fl | O_DIRECT) < 0) return false;
+
+  // frames are only guaranteed to be aligned to the page size, so probe
+  // with a buffer that is aligned to pageSize but not to 2 * pageSize
+  if (posix_memalign(&mem, 2 * pageSize, 2 * pageSize) == 0) {
+    n = ::pread(fd, (char*)mem + pageSize, pageSize, 0);
+    free(mem);
+  }
+  if (n < 0) {
+    ::fcntl(fd, F_SETFL, fl);
+    return false;
+  }
+  return true;
+}
+
+bool PageFile::isValidPageSize(int size)
+{
+  // a power of two between PAGE_SIZE and MAX_PAGE_SIZE
+  return size >= PAGE_SIZE && size <= MAX_PAGE_SIZE && (size & (size - 1)) == 0;
+}
+
+RC PageFile::setCreatePageSize(int size)
+{
+  if (!isValidPageSize(size)) return RC_INVALID_ATTRIBUTE;
+  createPageSize = size;
+  return 0;
+}
+
 RC PageFile::close()
 {
+  RC rc;
+  BufferPool& pool = BufferPool::getPool(pageSize);
+
   if (fd <= 0) return RC_FILE_CLOSE_FAILED;
 
+  // background reads must not land in frames that are given away
+  waitPrefetch();
+
+  // write the dirty pages of this file back to the disk, and then
+  // the list of free pages (which may overwrite pages freed while dirty)
+  rc = pool.flushFile(this);
+  if (rc == 0) {
+    std::unique_lock<std::mutex> lock(freeLatch);
+    rc = saveFreeList();
+  }
+
+  // remember the hottest pages for the next run
+  if (warmupPages > 0 && map == NULL) saveWarmList();
+
+  // unmap the file
+  if (map != NULL) {
+    ::munmap(map, mapSize);
+    map = NULL;
+    mapSize = 0;
+  }
+
+  // give back the preallocated space that was not used
+  trimPreallocation();
+
   // close the file
-  if (::close(fd) < 0) return RC_FILE_CLOSE_FAILED;
+  if (::close(fd) < 0 && rc == 0) rc = RC_FILE_CLOSE_FAILED;
+  if (flags & LOGGED) WriteAheadLog::closed();
 
   // evict all cached pages for this file
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].lastAccessed != 0) {
-       readCache[i].fd = 0;
-       readCache[i].pid = 0;
-       readCache[i].lastAccessed = 0;
-    }
-  }
+  pool.invalidateFile(this);
 
-  // set the fd and epid to the initial state
-  fd = -1; 
-  epid = 0;
+  reset();
+  return rc;
+}
+
+RC PageFile::flush()
+{
+  if (fd <= 0) return RC_FILE_WRITE_FAILED;
+  return BufferPool::getPool(pageSize).flushFile(this);
+}
+
+RC PageFile::sync()
+{
+  RC rc;
+
+  if ((rc = flush()) < 0) return rc;
+  if (::fdatasync(fd) < 0) return RC_FILE_WRITE_FAILED;
   return 0;
 }
 
@@ -93,86 +595,537 @@ PageId PageFile::endPid() const
   return epid;
 }
 
-RC PageFile::seek(PageId pid) const
+RC PageFile::allocatePage(PageId& pid, PageId near)
 {
-  return (::lseek(fd, pid * PAGE_SIZE, SEEK_SET) < 0) ? RC_FILE_SEEK_FAILED : 0;
+  RC rc;
+  std::unique_lock<std::mutex> lock(freeLatch);
+
+  if (fd < 0 || !writable || map != NULL) return RC_FILE_WRITE_FAILED;
+
+  // without free pages, the file grows
+  if (freePages.empty()) {
+    pid = epid;
+    if (pid > maxPid()) return RC_FILE_WRITE_FAILED;
+    extend(pid);
+    return 0;
+  }
+
+  // the saved list becomes invalid once one of its pages is reused, so
+  // the header must stop pointing to it on the disk before the page is
+  // handed out
+  if (freeCount > 0) {
+    PageId head = freeHead;
+    PageId count = freeCount;
+    freeHead = -1;
+    freeCount = 0;
+    rc = writeHeader();
+    if (rc == 0 && ::fdatasync(fd) < 0) rc = RC_FILE_WRITE_FAILED;
+    if (rc < 0) {
+      freeHead = head;
+      freeCount = count;
+      return rc;
+    }
+  }
+
+  // take the free page closest to near
+  std::set<PageId>::iterator it = freePages.begin();
+  if (near >= 0) {
+    it = freePages.lower_bound(near);
+    if (it == freePages.end() ||
+        (it != freePages.begin() && near - *std::prev(it) < *it - near)) {
+      it--;
+    }
+  }
+  pid = *it;
+  freePages.erase(it);
+  freeChanged = true;
+
+  return 0;
+}
+
+RC PageFile::freePage(PageId pid)
+{
+  std::unique_lock<std::mutex> lock(freeLatch);
+
+  if (fd < 0 || !writable || map != NULL) return RC_FILE_WRITE_FAILED;
+  if (pid < 0 || pid >= epid || freePages.count(pid) > 0) return RC_INVALID_PID;
+
+  freePages.insert(pid);
+  freeChanged = true;
+  BufferPool::getPool(pageSize).invalidate(this, pid);
+
+  return 0;
+}
+
+PageId PageFile::freePageCount() const
+{
+  std::unique_lock<std::mutex> lock(freeLatch);
+  return (PageId)freePages.size();
+}
+
+void PageFile::extend(PageId pid)
+{
+  // if the written pid >= end pid, update the end pid
+  PageId e = epid;
+  while (pid >= e && !epid.compare_exchange_weak(e, pid + 1));
+
+  // allocate more disk space if the page lies beyond it
+  PageId a = allocEnd;
+  if ((flags & PREALLOCATE) && a >= 0 && pid >= a) preallocate(pid);
+}
+
+void PageFile::preallocate(PageId pid)
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+  int step = growthStep;
+  std::unique_lock<std::mutex> lock(growLatch);
+
+  // another thread may have allocated the space in the meantime
+  PageId start = allocEnd;
+  if (step <= 0 || !(flags & PREALLOCATE) || start < 0 || pid < start) return;
+
+  // allocate the pages from the current end to (pid + step) without
+  // changing the size of the file. the step grows with the file, so that
+  // a file that grows along with others (e.g., a table and its index
+  // being loaded) gets ever larger extents. if the file system cannot
+  // preallocate, the file just grows page by page as pages are written.
+  if (step < start / 2) step = start / 2;
+  PageId end = pid + step;
+  if (::fallocate(fd, FALLOC_FL_KEEP_SIZE, offset(start), offset(end) - offset(start)) < 0) {
+    allocEnd = -1;
+    return;
+  }
+  allocEnd = end;
+#endif
+}
+
+void PageFile::trimPreallocation()
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+  struct stat statbuf;
+  PageId end = allocEnd;
+
+  if (!(flags & PREALLOCATE) || end <= 0 || ::fstat(fd, &statbuf) < 0) return;
+
+  // truncating the file to its own size frees the blocks beyond the end
+  // (punching a hole there is ignored by some file systems, e.g., ext4)
+  if (offset(end) > statbuf.st_size) {
+    if (::ftruncate(fd, statbuf.st_size) < 0) return;
+  }
+#endif
 }
 
 RC PageFile::write(PageId pid, const void* buffer)
 {
   RC rc;
-  if (pid < 0) return RC_INVALID_PID; 
+  BufferPool& pool = BufferPool::getPool(pageSize);
+  char* frame;
+  long long lsn = 0;
 
-  // seek to the location of the page
-  if ((rc = seek(pid) < 0)) return rc;
+  if (pid < 0 || pid > maxPid()) return RC_INVALID_PID;
 
-  // write the buffer to the disk page
-  if (::write(fd, buffer, PAGE_SIZE) < 0) return RC_FILE_WRITE_FAILED;
-
-  // if the page is in read cache, invalidate it
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid &&
-        readCache[i].lastAccessed != 0) {
-       readCache[i].fd = 0;
-       readCache[i].pid = 0;
-       readCache[i].lastAccessed = 0;
-       break;
+  // a mapped file is read-only
+  if (map != NULL) return RC_FILE_WRITE_FAILED;
+
+  // the change goes to the log before anywhere else
+  if ((flags & LOGGED) &&
+      (rc = WriteAheadLog::logPage(name, pid, pageSize, flags, (const char*)buffer, dataSize, lsn)) < 0) {
+    return rc;
+  }
+
+  if (flags & WRITE_BACK) {
+    // update the page in the buffer pool only and mark it dirty.
+    // if every frame is pinned, fall through to write it to the disk.
+    if ((frame = pool.allocate(this, pid)) != NULL) {
+      if (frame != buffer) memcpy(frame, buffer, dataSize);
+      pool.markDirty(this, pid, lsn);
+      pool.ready(this, pid);
+      pool.unpin(this, pid);
+
+      extend(pid);
+      return 0;
     }
   }
 
-  // if the written pid >= end pid, update the end pid
-  if (pid >= epid) epid = pid + 1;
+  // the record of the change must be durable before the page is written
+  if (lsn > 0 && (rc = WriteAheadLog::flush(lsn)) < 0) return rc;
+
+  // write the buffer to the disk page
+  if ((rc = writePage(pid, (const char*)buffer)) < 0) return rc;
+
+  // if the page is in the buffer pool, bring the frame up to date
+  // (unless the buffer is the frame itself). otherwise forget any
+  // compressed copy of the old content.
+  if ((frame = pool.pin(this, pid)) != NULL) {
+    if (frame != buffer) memcpy(frame, buffer, dataSize);
+    pool.unpin(this, pid);
+  } else {
+    pool.invalidate(this, pid);
+  }
+
+  extend(pid);
+
+  return 0;
+}
+
+RC PageFile::writePage(PageId pid, const char* page, bool sealed) const
+{
+  long long start, lsn;
+  RC rc;
+
+  // a logged page changed since the last commit can be undone
+  if ((rc = saveUndo(pid, lsn)) < 0) return rc;
+  if (lsn > 0 && (rc = WriteAheadLog::flush(lsn)) < 0) return rc;
+
+  // direct I/O needs an aligned buffer, and a checksum needs room after
+  // the data. frames have both, but the caller's buffer may not.
+  if ((checksums && !sealed) || ((flags & DIRECT) && (uintptr_t)page % pageSize != 0)) {
+    void* aligned;
+    ssize_t n;
+    if (posix_memalign(&aligned, pageSize, pageSize) != 0) return RC_FILE_WRITE_FAILED;
+    memcpy(aligned, page, sealed ? pageSize : dataSize);
+    if (!sealed) seal((char*)aligned);
+    start = IOStats::now();
+    n = ::pwrite(fd, aligned, pageSize, offset(pid));
+    free(aligned);
+    if (n != pageSize) return RC_FILE_WRITE_FAILED;
+  }
+
+  // write the page to the disk
+  else {
+    start = IOStats::now();
+    if (::pwrite(fd, page, pageSize, offset(pid)) != pageSize) return RC_FILE_WRITE_FAILED;
+  }
 
   // increase page write count
   writeCount++;
+  IOStats::countWrite(stats, IOStats::now() - start);
+  IOStats::countWriteCall(stats, pageSize);
 
   return 0;
 }
 
+RC PageFile::saveUndo(PageId pid, long long& lsn) const
+{
+  struct stat statbuf;
+  void* page;
+  ssize_t n;
+  RC rc;
+
+  lsn = 0;
+  if (!(flags & LOGGED) || !WriteAheadLog::needsUndo(name, pid, offset(pid))) return 0;
+
+  if (posix_memalign(&page, pageSize, pageSize) != 0) return RC_FILE_READ_FAILED;
+  n = ::pread(fd, page, pageSize, offset(pid));
+  if (n < 0) {
+    free(page);
+    return RC_FILE_READ_FAILED;
+  }
+
+  // a page past the end of the file is undone by cutting the file back
+  // to its current length
+  if (n == pageSize) rc = WriteAheadLog::logUndo(name, pid, offset(pid), (const char*)page, pageSize, lsn);
+  else if (::fstat(fd, &statbuf) < 0) rc = RC_FILE_READ_FAILED;
+  else rc = WriteAheadLog::logUndo(name, pid, statbuf.st_size, NULL, 0, lsn);
+  free(page);
+  return rc;
+}
+
+void PageFile::seal(char* page) const
+{
+  if (!checksums) return;
+
+  uint32_t crc = crc32c(page, dataSize);
+  memcpy(page + dataSize, &crc, CHECKSUM_SIZE);
+}
+
+bool PageFile::verify(const char* page) const
+{
+  uint32_t crc;
+
+  if (!checksums) return true;
+
+  memcpy(&crc, page + dataSize, CHECKSUM_SIZE);
+  if (crc == crc32c(page, dataSize)) return true;
+
+  // a page that was allocated but never written reads as zeros
+  for (int i = 0; i < pageSize; i++) {
+    if (page[i] != 0) return false;
+  }
+  return true;
+}
+
 RC PageFile::read(PageId pid, void* buffer) const
 {
   RC rc;
+  char* page;
+
+  // pin the page and copy it to the buffer
+  if ((rc = pin(pid, page)) < 0) return rc;
+  memcpy(buffer, page, dataSize);
+  unpin(pid);
+
+  return 0;
+}
+
+RC PageFile::pin(PageId pid, char*& page) const
+{
+  BufferPool& pool = BufferPool::getPool(pageSize);
+  bool fresh;
+  ssize_t n;
+  RC rc = RC_FILE_READ_FAILED;
 
   if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
 
+  // a mapped file is served straight from the mapping
+  if (map != NULL) {
+    page = map + offset(pid);
+    return 0;
+  }
+
+  // start reading the following pages if the file is read sequentially
+  readahead(pid);
+
   //
-  // if the page is in cache, read it from there
+  // if the page is in the buffer pool, return its frame.
+  // otherwise a frame is allocated for it, evicting the least recently
+  // used page.
   //
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid && 
-        readCache[i].lastAccessed != 0) {
-       memcpy(buffer, readCache[i].buffer, PAGE_SIZE);
-       readCache[i].lastAccessed = ++cacheClock;
-       return 0;
-    }
+  if ((page = pool.allocate(this, pid, &fresh, &rc)) == NULL) return rc;
+  if (!fresh) return 0;
+
+  // read the page into the frame
+  long long start = IOStats::now();
+  if ((n = ::pread(fd, page, pageSize, offset(pid))) < 0) {
+    pool.discard(this, pid);
+    return RC_FILE_READ_FAILED;
   }
+  // the page may lie past the physical end of the file
+  if (n < pageSize) memset(page + n, 0, pageSize - n);
 
-  // seek to the page
-  if ((rc = seek(pid) < 0)) return rc;
-  
-  // find the cache slot to evict
-  int toEvict = 0; 
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].lastAccessed == 0) {
-      toEvict = i;
-      break;
+  // increase the page read count
+  readCount++;
+  IOStats::countRead(stats, IOStats::now() - start);
+
+  // a page from the disk is checked only here, not on every pin
+  if (!verify(page)) {
+    checksumErrors++;
+    pool.discard(this, pid);
+    return RC_INVALID_FILE_FORMAT;
+  }
+  pool.ready(this, pid);
+
+  return 0;
+}
+
+RC PageFile::pinNew(PageId pid, char*& page)
+{
+  if (pid < 0 || pid > maxPid()) return RC_INVALID_PID;
+  if (map != NULL) return RC_FILE_WRITE_FAILED;
+
+  // the old content of the page is not needed, so do not read it
+  BufferPool& pool = BufferPool::getPool(pageSize);
+  RC rc = RC_FILE_WRITE_FAILED;
+  if ((page = pool.allocate(this, pid, NULL, &rc)) == NULL) return rc;
+  memset(page, 0, pageSize);
+  pool.ready(this, pid);
+
+  return 0;
+}
+
+void PageFile::unpin(PageId pid) const
+{
+  if (map != NULL) return;
+  BufferPool::getPool(pageSize).unpin(this, pid);
+}
+
+RC PageFile::prefetch(const PageId* pids, int n) const
+{
+  BufferPool& pool = BufferPool::getPool(pageSize);
+  IOBatch* batch;
+  std::vector<struct iovec> run;
+  PageId first = 0;
+  char* page;
+
+  // a mapped file needs no prefetching
+  if (map != NULL || fd < 0) return 0;
+
+  batch = new IOBatch;
+  for (int i = 0; i <= n; i++) {
+    page = NULL;
+    if (i < n && pids[i] >= 0 && pids[i] < epid) {
+      // skip cached pages. waiting for pages loaded by other threads
+      // while holding unsubmitted frames could deadlock.
+      page = pool.allocateAbsent(this, pids[i]);
     }
-    if (readCache[i].lastAccessed < readCache[toEvict].lastAccessed) {
-      toEvict = i;
+
+    // consecutive pages are read into their frames with a single I/O
+    if (!run.empty() && (page == NULL || pids[i] != first + (PageId)run.size())) {
+      batch->addReadv(fd, &run[0], (int)run.size(), offset(first), prefetched, this, first);
+      run.clear();
     }
+    if (page == NULL) continue;
+    if (run.empty()) first = pids[i];
+    struct iovec v = { page, (size_t)pageSize };
+    run.push_back(v);
   }
-  readCache[toEvict].fd = fd;
-  readCache[toEvict].pid = pid;
-  readCache[toEvict].lastAccessed = ++cacheClock;
- 
-  // read the page to cache first and copy it to the buffer
-  if (::read(fd, readCache[toEvict].buffer, PAGE_SIZE) < 0) {
-    return RC_FILE_READ_FAILED;
+
+  if (batch->size() == 0) {
+    delete batch;
+    return 0;
   }
-  memcpy(buffer, readCache[toEvict].buffer, PAGE_SIZE);
 
-  // increase the page read count
-  readCount++;
+  {
+    std::unique_lock<std::mutex> lock(prefetchLatch);
+    prefetching += batch->size();
+  }
+  batch->detach();
+
+  return 0;
+}
+
+RC PageFile::advise(PageId first, PageId n, Advice advice) const
+{
+  static const int fileAdvice[] = { POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL,
+    POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED };
+  static const int mapAdvice[] = { MADV_NORMAL, MADV_SEQUENTIAL,
+    MADV_RANDOM, MADV_WILLNEED, MADV_DONTNEED };
+
+  if (fd < 0) return RC_FILE_OPEN_FAILED;
+  if (first < 0 || n < 0) return RC_INVALID_PID;
+  if (advice < ADVISE_NORMAL || advice > ADVISE_DONTNEED) return RC_INVALID_ATTRIBUTE;
+  if (flags & DIRECT) return 0;
 
+  if (map != NULL) {
+    // madvise() takes whole OS pages; the header before page 0 is
+    // part of the mapping too
+    size_t osPage = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = (first == 0) ? 0 : (size_t)offset(first);
+    size_t end = (n == 0 || offset(first + n) > (off_t)mapSize) ? mapSize : (size_t)offset(first + n);
+    start &= ~(osPage - 1);
+    if (start >= end) return 0;
+    if (::madvise(map + start, end - start, mapAdvice[advice]) < 0) return RC_INVALID_ATTRIBUTE;
+    return 0;
+  }
+
+  // posix_fadvise() returns the error instead of setting errno
+  off_t len = (n == 0) ? 0 : (off_t)n * pageSize;
+  if (::posix_fadvise(fd, offset(first), len, fileAdvice[advice]) != 0) return RC_INVALID_ATTRIBUTE;
   return 0;
 }
+
+void PageFile::readahead(PageId pid) const
+{
+  PageId start, end;
+  int window = readaheadPages;
+
+  if (window <= 0) return;
+
+  // a pin of the page right after the previous one continues a
+  // sequential run, and a pin of the same page again does not matter.
+  // anything else starts a new run.
+  if (nextPid.load(std::memory_order_relaxed) == pid + 1) return;
+  if (nextPid.exchange(pid + 1, std::memory_order_relaxed) != pid) {
+    seqCount.store(0, std::memory_order_relaxed);
+    raEnd.store(0, std::memory_order_relaxed);
+    return;
+  }
+  if (seqCount.fetch_add(1, std::memory_order_relaxed) + 1 < READAHEAD_TRIGGER) return;
+
+  // keep at least half a window read ahead of the reader
+  start = raEnd.load(std::memory_order_relaxed);
+  if (start <= pid) start = pid + 1;
+  if (start - pid > window / 2) return;
+  end = start + window;
+  if (end > epid) end = epid;
+  if (start >= end) return;
+  raEnd.store(end, std::memory_order_relaxed);
+
+  std::vector<PageId> pids;
+  for (PageId p = start; p < end; p++) pids.push_back(p);
+  prefetch(&pids[0], (int)pids.size());
+}
+
+void PageFile::prefetched(IORequest& req)
+{
+  const PageFile* file = (const PageFile*)req.arg;
+  BufferPool& pool = BufferPool::getPool(file->pageSize);
+  PageId first = (PageId)req.tag;
+  int n = req.iov.empty() ? 1 : (int)req.iov.size();
+
+  for (int i = 0; i < n; i++) {
+    PageId pid = first + i;
+    char* page = req.iov.empty() ? req.buf : (char*)req.iov[i].iov_base;
+    ssize_t got = req.result - (ssize_t)i * file->pageSize;
+
+    if (req.result < 0) {
+      pool.discard(file, pid);
+      continue;
+    }
+    // the page may lie past the physical end of the file
+    if (got < 0) got = 0;
+    if (got < file->pageSize) memset(page + got, 0, file->pageSize - got);
+    readCount++;
+    IOStats::countRead(file->stats, req.latency);
+
+    // a corrupt page is dropped; reading it again reports the error
+    if (!file->verify(page)) {
+      checksumErrors++;
+      pool.discard(file, pid);
+      continue;
+    }
+    pool.ready(file, pid);
+    pool.unpin(file, pid);
+  }
+
+  std::unique_lock<std::mutex> lock(file->prefetchLatch);
+  if (--file->prefetching == 0) file->prefetchDone.notify_all();
+}
+
+void PageFile::warmUp() const
+{
+  WarmupHeader header;
+  std::vector<PageId> pids;
+  int n, wfd;
+
+  {
+    std::unique_lock<std::mutex> lock(warmupLists.latch);
+    if (!warmupLists.read.insert(warmName).second) return;
+  }
+
+  // leave most of the buffer pool to the pages that are asked for
+  n = std::min(warmupPages.load(), BufferPool::getPool(pageSize).getFrameCount() / 4);
+
+  // the list is only a hint: if it is missing or broken, nothing is read
+  if ((wfd = ::open(warmName.c_str(), O_RDONLY)) < 0) return;
+  if (::read(wfd, &header, sizeof(header)) == sizeof(header)
+      && header.magic == WARMUP_MAGIC && header.count > 0) {
+    pids.resize(std::min(n, header.count));
+    size_t size = pids.size() * sizeof(PageId);
+    if (pids.empty() || ::read(wfd, &pids[0], size) != (ssize_t)size) pids.clear();
+  }
+  ::close(wfd);
+
+  // read the hottest pages in the order of pid, so that the disk is
+  // scanned once and neighboring pages are read with a single I/O
+  std::sort(pids.begin(), pids.end());
+  if (!pids.empty()) prefetch(&pids[0], (int)pids.size());
+}
+
+void PageFile::saveWarmList() const
+{
+  std::vector<PageId> pids;
+
+  // keep the old list if no page of the file was used this time
+  BufferPool::getPool(pageSize).hottestPages(this, warmupPages, pids);
+  if (pids.empty()) return;
+
+  std::unique_lock<std::mutex> lock(warmupLists.latch);
+  warmupLists.latest[warmName].swap(pids);
+}
+
+void PageFile::waitPrefetch() const
+{
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  while (prefetching > 0) prefetchDone.wait(lock);
+}
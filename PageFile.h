@@ -11,46 +11,222 @@
 #define PAGEFILE_H
 
 #include <string>
+#include <cstring>
+#include <climits>
+#include <stdint.h>
+#include <set>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
 #include "Bruinbase.h"
 
-typedef int PageId;
+// page ids, file offsets and I/O statistics are 64-bit, so that files
+// are not limited to 2^31 pages. a file stores the page ids in its pages
+// (e.g., in B+tree nodes) in getPidSize() bytes.
+typedef long long PageId;
+
+struct IORequest;
+class IOStats;
 
 /**
- * read/write a file in the unit of a page
+ * read/write a file in the unit of a page.
+ * the page size of a file is chosen when the file is created (see
+ * setCreatePageSize()) and recorded in a header at the beginning of the
+ * file. files without a header have pages of PAGE_SIZE bytes.
+ * all disk I/O is positional (pread/pwrite), so any number of threads
+ * may read pages of the same PageFile concurrently.
+ * pages given back by freePage() are reused by allocatePage(). the list
+ * of free pages is kept in memory while the file is open, and saved in
+ * free pages (chained from the header) when the file is closed.
+ * the header also records the format version of the file. files of
+ * version 1 (or without a header) store page ids in 4 bytes and cannot
+ * grow past 2^31 pages; files created now are of version 2 and store
+ * page ids in 8 bytes.
  */
 class PageFile {
  public:
 
-  static const int PAGE_SIZE = 1024;    // the size of a page is 1KB
+  static const int PAGE_SIZE = 1024;    // the default (and smallest) page size
+  static const int MAX_PAGE_SIZE = 16384; // the largest page size
+
+  //
+  // options for open(). they can be combined with bitwise OR.
+  //
+
+  // write-back caching: write() only updates the page in the buffer pool
+  // and marks it dirty. dirty pages are written to the disk when they are
+  // evicted, when the file is closed, or when flush() is called.
+  static const int WRITE_BACK = 0x1;
+
+  // memory-mapped backend for files opened in 'r' mode: the whole file is
+  // mapped, and read() and pin() are served from the mapping without
+  // system calls or the buffer pool. ignored in 'w' mode.
+  static const int MMAP = 0x2;
+
+  // direct I/O: the file is opened with O_DIRECT so that pages are
+  // cached only in the buffer pool, not also in the OS page cache.
+  // if the file system does not support it, the option is ignored.
+  static const int DIRECT = 0x4;
+
+  // page checksums for files created in 'w' mode: the last
+  // CHECKSUM_SIZE bytes of every page hold the CRC32C of the rest, which
+  // is filled in when the page is written to the disk and verified when
+  // it is read from the disk (but not when it is found in the buffer
+  // pool). whether a file has checksums is recorded in its header, so
+  // for an existing file the option is replaced by what the header says.
+  static const int CHECKSUM = 0x8;
+  static const int CHECKSUM_SIZE = 4;
+
+  // readahead: once READAHEAD_TRIGGER pages in a row are pinned in the
+  // order of pid, the pages that follow are read into the buffer pool in
+  // the background, up to a window of getReadahead() pages ahead.
+  static const int DEFAULT_READAHEAD = 32;
+  static const int READAHEAD_TRIGGER = 2;
+
+  // preallocation for files opened in 'w' mode: when the file grows past
+  // the disk space allocated to it, the space for getGrowthStep() more
+  // pages (or half the allocated pages, if more) is allocated at once
+  // (with fallocate), so that a growing file gets few large extents.
+  // the size of the file, and so endPid(), is not changed by this, and
+  // the space still unused at close() is given back. this pays off where
+  // the OS cannot delay the allocation of written blocks, e.g., under
+  // DIRECT. ignored if the file system does not support it.
+  static const int PREALLOCATE = 0x10;
+  static const int DEFAULT_GROWTH_STEP = 256;
+
+  // write-ahead logging for files opened in 'w' mode: every write() of a
+  // page is appended to the write-ahead log before the page is changed,
+  // and the log is made durable up to a dirty page before the page is
+  // written to the file (see WriteAheadLog.h). ignored unless the log is
+  // open when the file is opened. implies WRITE_BACK.
+  static const int LOGGED = 0x20;
+
+  // buffer pool warm-up across restarts: when a file is closed, the pages
+  // it has in the buffer pool are listed, hottest first (see
+  // BufferPool::hottestPages()), in a file named after it with the suffix
+  // WARMUP_SUFFIX. when the file is opened for the first time by another
+  // process, the first getWarmup() pages of the list (but no more than a
+  // quarter of the buffer pool) are prefetched in the order of pid.
+  // the lists are written by saveWarmupLists() when the process shuts
+  // down, with the pages of the last close() of each file. warm-up is disabled (getWarmup() is 0) by
+  // default, and ignored for files under MMAP.
+  static const char* const WARMUP_SUFFIX;
 
   PageFile();
-  PageFile(const std::string& filename, char mode);
+  PageFile(const std::string& filename, char mode, int flags = 0);
+  ~PageFile();
 
   /**
    * open a file in read or write mode.
-   * when opened in 'w' mode, if the file does not exist, it is created.
+   * when opened in 'w' mode, if the file does not exist, it is created
+   * with pages of getCreatePageSize() bytes.
    * @param filename[IN] the name of the file to open
    * @param mode[IN] 'r' for read, 'w' for write
+   * @param flags[IN] open options (e.g., WRITE_BACK, MMAP, DIRECT). 0 for none
    * @return error code. 0 if no error
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, int flags = 0);
 
   /**
-   * close the file.
+   * close the file. dirty pages are written to the disk first.
    * @return error code. 0 if no error
    */
   RC close();
+
+  /**
+   * write all dirty pages of the file to the disk, in the order of pid.
+   * this is a no-op unless the file was opened with WRITE_BACK.
+   * @return error code. 0 if no error
+   */
+  RC flush();
+
+  /**
+   * write all dirty pages of the file to the disk and wait until they
+   * are stable (with fdatasync).
+   * @return error code. 0 if no error
+   */
+  RC sync();
   
   /**
    * read a disk page into memory buffer.
    * @param pid[IN] the page to read
-   * @param buffer[OUT] pointer to memory buffer
+   * @param buffer[OUT] pointer to memory buffer of getPageSize() bytes
    * @return error code. 0 if no error
    */
   RC read(PageId pid, void *buffer) const;
+
+  /**
+   * pin a disk page in the buffer pool and return a pointer to the
+   * frame that holds it. unlike read(), the page is not copied.
+   * the frame stays valid until it is released by unpin(pid).
+   * the frame may be modified in place and then written with
+   * write(pid, page), which does not copy it either.
+   * @param pid[IN] the page to pin
+   * @param page[OUT] pointer to the frame of the page
+   * @return error code. 0 if no error
+   */
+  RC pin(PageId pid, char*& page) const;
+
+  /**
+   * pin a zero-filled frame for a page whose old content (if any) is
+   * going to be overwritten. nothing is read from the disk, and pid may
+   * be endPid() or larger; the page is created when it is written.
+   * the frame must be released by unpin(pid).
+   * @param pid[IN] the page to pin
+   * @param page[OUT] pointer to the frame of the page
+   * @return error code. 0 if no error
+   */
+  RC pinNew(PageId pid, char*& page);
+
+  /**
+   * start reading pages into the buffer pool in the background, so that
+   * a later read() or pin() of them does not wait for the disk.
+   * the reads are submitted together as one asynchronous batch (see
+   * AsyncIO.h), and consecutive pages are read with a single I/O.
+   * pages that are already cached, or that are out of range,
+   * are skipped, and so are all pages once a quarter of the buffer pool
+   * is pinned.
+   * @param pids[IN] the pages to read
+   * @param n[IN] # pages in pids
+   * @return error code. 0 if no error
+   */
+  RC prefetch(const PageId* pids, int n) const;
+
+  // how a range of pages is going to be accessed (see advise())
+  enum Advice {
+    ADVISE_NORMAL,      // no particular pattern (the default)
+    ADVISE_SEQUENTIAL,  // in order, e.g., by a table scan
+    ADVISE_RANDOM,      // in no order, e.g., through an index
+    ADVISE_WILLNEED,    // soon
+    ADVISE_DONTNEED     // not again soon
+  };
+
+  /**
+   * tell the OS how a range of pages is going to be accessed, so that
+   * its page cache works with the buffer pool instead of against it:
+   * e.g., the kernel reads ahead aggressively for ADVISE_SEQUENTIAL, not
+   * at all for ADVISE_RANDOM, and drops the cached pages for
+   * ADVISE_DONTNEED. this is posix_fadvise(), or madvise() on the
+   * mapping under MMAP. a file under DIRECT has no pages in the page
+   * cache, so the advice is ignored. the advice is only a hint.
+   * @param first[IN] the first page of the range
+   * @param n[IN] # pages of the range. 0 for all pages from first on
+   * @param advice[IN] the access pattern
+   * @return error code. 0 if no error
+   */
+  RC advise(PageId first, PageId n, Advice advice) const;
+
+  /**
+   * release a pin obtained by pin() or pinNew().
+   * @param pid[IN] the page to unpin
+   */
+  void unpin(PageId pid) const;
   
   /**
    * write the memory buffer to the disk page.
+   * under WRITE_BACK, the page is only updated in the buffer pool.
+   * the buffer may be the pinned frame of the page itself.
    * if (pid >= endPid()), the file is expanded such that
    * endPid() becomes (pid + 1).
    * @param pid[IN] page to write to
@@ -58,6 +234,34 @@ class PageFile {
    * @return error code. 0 if no error
    */
   RC write(PageId pid, const void *buffer);
+
+  /**
+   * allocate a page: reuse the free page closest to near (preferring
+   * the following one on a tie), or take endPid() if there is no free
+   * page, in which case endPid() grows by one.
+   * the content of the page is undefined until it is written.
+   * @param pid[OUT] the allocated page
+   * @param near[IN] a page the new page is related to (e.g., its sibling
+   *                 in a tree), so that related pages stay close on the
+   *                 disk. -1 for none
+   * @return error code. 0 if no error
+   */
+  RC allocatePage(PageId& pid, PageId near = -1);
+
+  /**
+   * give a page back for reuse by allocatePage().
+   * the page must not be used afterwards (its cached frame is dropped).
+   * free pages are only remembered across open() for files with a
+   * header; in a file without one they stay unused after close().
+   * @param pid[IN] the page to free
+   * @return error code. 0 if no error
+   */
+  RC freePage(PageId pid);
+
+  /**
+   * @return # free pages
+   */
+  PageId freePageCount() const;
     
   /**
    * note the +1 part. The last page id in the file is actually endPid()-1.
@@ -67,46 +271,253 @@ class PageFile {
   PageId endPid() const;
 
   /**
-   * @return the total # of disk reads
+   * @return the options in effect. an option that could not be used
+   *         (e.g., DIRECT on a file system without direct I/O) is cleared
+   */
+  int getFlags() const { return flags; }
+
+  /**
+   * @return the # bytes of a page available to the caller: the page size
+   *         of the file, less CHECKSUM_SIZE if the file has checksums
+   */
+  int getPageSize() const { return dataSize; }
+
+  /**
+   * @return the # bytes of a page id stored in a page of the file:
+   *         4 in files of format version 1, 8 otherwise
+   */
+  int getPidSize() const { return pidSize; }
+
+  /**
+   * @return the largest page id the file can hold (and store in its pages)
+   */
+  PageId maxPid() const { return (pidSize == sizeof(int)) ? INT_MAX : LLONG_MAX; }
+
+  /**
+   * read a page id stored in getPidSize() bytes.
+   * @param p[IN] the location of the page id in a page of the file
+   * @return the page id
+   */
+  PageId loadPid(const char* p) const
+  {
+    if (pidSize == sizeof(int)) {
+      int v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+    PageId v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  /**
+   * store a page id in getPidSize() bytes.
+   * @param p[OUT] the location of the page id in a page of the file
+   * @param pid[IN] the page id. at most maxPid(), or -1
+   */
+  void storePid(char* p, PageId pid) const
+  {
+    if (pidSize == sizeof(int)) {
+      int v = (int)pid;
+      memcpy(p, &v, sizeof(v));
+      return;
+    }
+    memcpy(p, &pid, sizeof(pid));
+  }
+
+  /**
+   * set the page size of the files created from now on.
+   * @param size[IN] a power of two from PAGE_SIZE to MAX_PAGE_SIZE
+   * @return error code. 0 if no error
+   */
+  static RC setCreatePageSize(int size);
+
+  /**
+   * @return the page size of the files created from now on
+   */
+  static int getCreatePageSize() { return createPageSize.load(); }
+
+  /**
+   * @param size[IN] a page size
+   * @return true if files can have pages of the size
+   */
+  static bool isValidPageSize(int size);
+
+  /**
+   * set the readahead window for all files.
+   * @param pages[IN] # pages to read ahead. 0 disables readahead
+   */
+  static void setReadahead(int pages) { readaheadPages = (pages > 0) ? pages : 0; }
+
+  /**
+   * @return the readahead window in pages
+   */
+  static int getReadahead() { return readaheadPages.load(); }
+
+  /**
+   * set the preallocation step for all files.
+   * @param pages[IN] # pages to allocate at a time. 0 disables preallocation
+   */
+  static void setGrowthStep(int pages) { growthStep = (pages > 0) ? pages : 0; }
+
+  /**
+   * @return the preallocation step in pages
+   */
+  static int getGrowthStep() { return growthStep.load(); }
+
+  /**
+   * set the warm-up list length for all files.
+   * @param pages[IN] # pages to list and prefetch. 0 disables warm-up
+   */
+  static void setWarmup(int pages) { warmupPages = (pages > 0) ? pages : 0; }
+
+  /**
+   * @return the warm-up list length in pages
+   */
+  static int getWarmup() { return warmupPages.load(); }
+
+  /**
+   * write the warm-up lists of the files closed so far, for the next
+   * process. called when the process shuts down.
    */
-  static int getPageReadCount()  { return readCount; }
+  static void saveWarmupLists();
+
+  /**
+   * @return the total # of disk reads.
+   * pages served from an MMAP mapping are not counted.
+   */
+  static long long getPageReadCount()  { return readCount.load(); }
   
   /**
    * @return the total # of disk writes
    */
-  static int getPageWriteCount() { return writeCount; }
+  static long long getPageWriteCount() { return writeCount.load(); }
+
+  /**
+   * @return the total # of pages read from the disk whose checksum
+   *         did not match
+   */
+  static long long getChecksumErrorCount() { return checksumErrors.load(); }
 
  protected:
   /**
-   * move the file cursor to the beginning of a page.
+   * compute the offset of a page in the file.
    * this is an internal function not exposed to public.
-   * @param pid[IN] page to seek to
+   * @param pid[IN] the page
+   * @return the file offset of the first byte of the page
+   */
+  off_t offset(PageId pid) const { return base + (off_t)pid * pageSize; }
+
+  /**
+   * write a page to the disk, bypassing the buffer pool.
+   * the buffer pool calls this to write back dirty frames.
+   * @param pid[IN] page to write to
+   * @param page[IN] the content to write (getPageSize() bytes)
+   * @param sealed[IN] true if page is a whole page whose checksum was
+   *                   filled in by seal()
    * @return error code. 0 if no error
    */
-  RC seek(PageId pid) const;
+  RC writePage(PageId pid, const char* page, bool sealed = false) const;
+
+  /**
+   * log the content of a page on the disk before the page is written, if
+   * the file is logged and the page changed since the last commit (see
+   * WriteAheadLog::logUndo()).
+   * @param pid[IN] the page about to be written
+   * @param lsn[OUT] the log record, to be made durable before the write.
+   *                 0 if none
+   * @return error code. 0 if no error
+   */
+  RC saveUndo(PageId pid, long long& lsn) const;
+
+  /**
+   * fill in the checksum of a whole page, if the file has checksums.
+   * @param page[IN/OUT] the page
+   */
+  void seal(char* page) const;
+
+  /**
+   * @param page[IN] a whole page read from the disk
+   * @return true if the checksum of the page matches (or the file has
+   *         no checksums, or the page was never written)
+   */
+  bool verify(const char* page) const;
+
+  friend class BufferPool;
 
  private:
   int     fd;     // file descriptor of the associated unix file
-  PageId  epid;   // (last page id + 1) of the file
+  std::atomic<PageId> epid; // (last page id + 1) of the file
+  int     flags;  // the options given to open()
+  bool    writable; // true if the file was opened in 'w' mode
+  int     pageSize; // the page size of the file
+  int     dataSize; // pageSize less the checksum, if any
+  bool    checksums;// true if the pages have checksums
+  int     version;  // the format version of the file
+  int     pidSize;  // the # bytes of a page id in the pages of the file
+  off_t   base;   // the offset of page 0. the size of the header, if any
+  char*   map;    // the mapping of the file under MMAP. NULL otherwise
+  size_t  mapSize;// the length of the mapping
+  IOStats* stats; // the I/O statistics of the file (see IOStats.h)
+  std::string warmName; // the name of the warm-up list of the file
+  std::string name;     // the name of the file
+  uint64_t fileId;      // the device and inode of the file, which identify
+                        // its pages across opens (see BufferPool::pageKeyOf())
 
-  //
-  // the following set of members implement LRU caching 
-  //
-  static const int CACHE_COUNT = 10;
+  PageFile(const PageFile&);
+  PageFile& operator=(const PageFile&);
+
+  // cached pages are kept in the shared BufferPool (see BufferPool.h)
+
+  // free pages. the list saved on the disk starts at page freeHead and
+  // has freeCount pages (see saveFreeList()); it is cleared as soon as a
+  // free page is reused, so that a crash may only leak free pages.
+  std::set<PageId> freePages;
+  bool    freeChanged;  // true if freePages differs from the saved list
+  PageId  freeHead;     // the first page of the saved list
+  PageId  freeCount;    // # pages in the saved list
+  long long freeSum;    // the checksum of the saved list (see
+                        //   loadFreeList()). -1 if it has none
+  mutable std::mutex freeLatch;  // protects the five above
+
+  static std::atomic<long long> readCount;  // total # of page reads
+  static std::atomic<long long> writeCount; // total # of page writes
+  static std::atomic<long long> checksumErrors; // total # of checksum mismatches
+  static std::atomic<int> readaheadPages; // the readahead window
+  static std::atomic<int> growthStep;     // the preallocation step
+  static std::atomic<int> warmupPages;    // the warm-up list length
+  static std::atomic<int> createPageSize; // the page size of new files
+
+  // sequential access detection for readahead (see readahead())
+  mutable std::atomic<PageId> nextPid;  // the pid that continues the run
+  mutable std::atomic<int>    seqCount; // # pages pinned in a row
+  mutable std::atomic<PageId> raEnd;    // the end of the pages read ahead
 
-  static int cacheClock; // clock tick counter for LRU policy
+  // the end of the disk space allocated by preallocate(). -1 if the
+  // file system does not support preallocation
+  std::atomic<PageId> allocEnd;
+  std::mutex growLatch;  // serializes preallocate()
 
-  // the actual cache data structure
-  static struct cacheStruct {
-    int    fd;              // file id of the cached page
-    PageId pid;             // page id of the cached page
-    int    lastAccessed;    // the last time the cached page was accessed
-                            //   (lastAccessed == 0) means that the buffer is empty
-    char buffer[PAGE_SIZE]; // the buffer used for caching
-  } readCache[CACHE_COUNT];
+  // reads started by prefetch() that have not completed.
+  // close() waits for them before the frames of the file are dropped.
+  mutable int prefetching;
+  mutable std::mutex prefetchLatch;
+  mutable std::condition_variable prefetchDone;
 
-  static int readCount;  // total # of page reads 
-  static int writeCount; // total # of page writes 
+  void reset();
+  void extend(PageId pid);
+  void preallocate(PageId pid);
+  void trimPreallocation();
+  RC   readHeader(off_t size);
+  RC   writeHeader();
+  RC   loadFreeList();
+  RC   saveFreeList();
+  bool enableDirect();
+  void waitPrefetch() const;
+  void warmUp() const;
+  void saveWarmList() const;
+  void readahead(PageId pid) const;
+  static void prefetched(IORequest& req);
 };
   
 #endif // PAGEFILE_H
@@ -7,6 +7,8 @@
  * @date 3/24/2008
  */
 
+#include <algorithm>
+#include <vector>
 #include "Bruinbase.h"
 #include "RecordFile.h"
 
@@ -36,32 +38,6 @@ static void setRecordCount(char* page, int count);
 // helper functions for RecordId manipulation
 //
 
-// postfix record id iterator
-RecordId operator++ (RecordId& rid, int)
-{
-  RecordId prid(rid);
-
-  // if the end of a page is reached, move to the next page
-  if (++rid.sid >= RecordFile::RECORDS_PER_PAGE) {
-    rid.pid++;
-    rid.sid = 0;
-  }
-
-  return prid;
-}
-
-// prefix record id iterator
-RecordId& operator++ (RecordId& rid)
-{
-  // if the end of a page is reached, move to the next page
-  if (++rid.sid >= RecordFile::RECORDS_PER_PAGE) {
-    rid.pid++;
-    rid.sid = 0;
-  } 
-
-  return rid;
-}
-
 // RecordId comparators
 bool operator < (const RecordId& r1, const RecordId& r2)
 {
@@ -106,20 +82,25 @@ RecordFile::RecordFile()
 {
   erid.pid = 0;
   erid.sid = 0;
+  slotsPerPage = recordsPerPage(PageFile::PAGE_SIZE);
 }
 
-RecordFile::RecordFile(const string& filename, char mode)
+RecordFile::RecordFile(const string& filename, char mode, int flags)
 {
-  open(filename, mode);
+  erid.pid = 0;
+  erid.sid = 0;
+  slotsPerPage = recordsPerPage(PageFile::PAGE_SIZE);
+  open(filename, mode, flags);
 }
 
-RC RecordFile::open(const string& filename, char mode)
+RC RecordFile::open(const string& filename, char mode, int flags)
 {
   RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  char *page;
 
   // open the page file
-  if ((rc = pf.open(filename, mode)) < 0) return rc;
+  if ((rc = pf.open(filename, mode, flags)) < 0) return rc;
+  slotsPerPage = recordsPerPage(pf.getPageSize());
   
   //
   // in the rest of this function, we set the end record id
@@ -138,7 +119,7 @@ RC RecordFile::open(const string& filename, char mode)
   // obtain # records in the last page to set sid of the end record id.
   // read the last page of the file and get # records in the page.
   // remeber that the id of the last page is endPid()-1 not endPid().
-  if ((rc = pf.read(--erid.pid, page)) < 0) {
+  if ((rc = pf.pin(--erid.pid, page)) < 0) {
     // an error occurred during page read
     erid.pid = erid.sid = 0;
     pf.close();
@@ -147,7 +128,8 @@ RC RecordFile::open(const string& filename, char mode)
 
   // get # records in the last page
   erid.sid = getRecordCount(page);
-  if (erid.sid >= RECORDS_PER_PAGE) {
+  pf.unpin(erid.pid);
+  if (erid.sid >= slotsPerPage) {
     // the last page is full. advance the end record id to the next page.
     erid.pid++;
     erid.sid = 0;
@@ -167,35 +149,54 @@ RC RecordFile::close()
 RC RecordFile::read(const RecordId& rid, int& key, string& value) const
 {
   RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  char *page;
   
   // check whether the rid is in the valid range
   if (rid.pid < 0 || rid.pid > erid.pid) return RC_INVALID_RID;
-  if (rid.sid < 0 || rid.sid >= RecordFile::RECORDS_PER_PAGE) return RC_INVALID_RID;
+  if (rid.sid < 0 || rid.sid >= slotsPerPage) return RC_INVALID_RID;
   if (rid >= erid) return RC_INVALID_RID;
   
-  // read the page containing the record
-  if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  // pin the page containing the record (no copy of the page is made)
+  if ((rc = pf.pin(rid.pid, page)) < 0) return rc;
 
   // read the record from the slot in the page
   readSlot(page, rid.sid, key, value);
+  pf.unpin(rid.pid);
 
   return 0;
 }
 
+RC RecordFile::prefetch(const RecordId* rids, int n) const
+{
+  std::vector<PageId> pids;
+
+  // read each page once, in the order of pid
+  for (int i = 0; i < n; i++) pids.push_back(rids[i].pid);
+  std::sort(pids.begin(), pids.end());
+  pids.erase(std::unique(pids.begin(), pids.end()), pids.end());
+  if (pids.empty()) return 0;
+
+  return pf.prefetch(&pids[0], (int)pids.size());
+}
+
+RC RecordFile::advise(PageFile::Advice advice) const
+{
+  return pf.advise(0, 0, advice);
+}
+
 RC RecordFile::append(int key, const std::string& value, RecordId& rid)
 {
   RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  char *page;
 
   // unless we are writing to the the first slot of an empty page,
   // we have to read the page first
   if (erid.sid > 0) {
-    if ((rc = pf.read(erid.pid, page)) < 0) return rc;
+    if ((rc = pf.pin(erid.pid, page)) < 0) return rc;
   } else {
     // if this is the first slot of an empty page
     // we can simply initialize the page with zeros
-    memset(page, 0, PageFile::PAGE_SIZE);
+    if ((rc = pf.pinNew(erid.pid, page)) < 0) return rc;
   }
     
   // write the record to the first empty slot 
@@ -206,13 +207,15 @@ RC RecordFile::append(int key, const std::string& value, RecordId& rid)
   setRecordCount(page, erid.sid + 1);
 
   // write the page to the disk
-  if ((rc = pf.write(erid.pid, page)) < 0) return rc;
+  rc = pf.write(erid.pid, page);
+  pf.unpin(erid.pid);
+  if (rc < 0) return rc;
     
   // we need to output the rid of the record slot
   rid = erid;
 
   // advance the end record id by one to the next empty slot
-  ++erid;
+  advance(erid);
 
   return 0;
 }
@@ -222,6 +225,17 @@ const RecordId& RecordFile::endRid() const
   return erid;
 }
 
+RecordId& RecordFile::advance(RecordId& rid) const
+{
+  // if the end of a page is reached, move to the next page
+  if (++rid.sid >= slotsPerPage) {
+    rid.pid++;
+    rid.sid = 0;
+  }
+
+  return rid;
+}
+
 static int getRecordCount(const char* page)
 {
   int count;
@@ -26,10 +26,6 @@ typedef struct {
 // helper functions for RecordId
 // 
 
-// RecordId iterators
-RecordId& operator++ (RecordId& rid);
-RecordId  operator++ (RecordId& rid, int);
-
 // RecordId comparators
 bool operator> (const RecordId& r1, const RecordId& r2);
 bool operator< (const RecordId& r1, const RecordId& r2);
@@ -47,22 +43,27 @@ class RecordFile {
   // maximum length of the value field
   static const int MAX_VALUE_LENGTH = 100;  
 
-  // number of record slots per page
-  static const int RECORDS_PER_PAGE = (PageFile::PAGE_SIZE - sizeof(int))/ (sizeof(int) + MAX_VALUE_LENGTH);  
-    // Note that we subtract sizeof(int) from PAGE_SIZE because the first
-    // four bytes in the page is used to store # records in the page.
+  /**
+   * @param pageSize[IN] the page size of a file
+   * @return # record slots per page of pageSize bytes
+   */
+  static int recordsPerPage(int pageSize)
+    { return (pageSize - sizeof(int)) / (sizeof(int) + MAX_VALUE_LENGTH); }
+    // Note that we subtract sizeof(int) from the page size because the
+    // first four bytes in the page is used to store # records in the page.
 
   RecordFile();
-  RecordFile(const std::string& filename, char mode);
+  RecordFile(const std::string& filename, char mode, int flags = 0);
   
   /**
    * open a file in read or write mode.
    * when opened in 'w' mode, if the file does not exist, it is created.
    * @param filename[IN] the name of the file to open
    * @param mode[IN] 'r' for read, 'w' for write
+   * @param flags[IN] PageFile open options (e.g., PageFile::WRITE_BACK)
    * @return error code. 0 if no error
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, int flags = 0);
 
   /**
    * close the file.
@@ -79,6 +80,23 @@ class RecordFile {
    */
   RC read(const RecordId& rid, int& key, std::string& value) const;
 
+  /**
+   * start reading the pages of the given records in the background,
+   * so that reading the records later does not wait for the disk.
+   * @param rids[IN] the records that are going to be read
+   * @param n[IN] # records in rids
+   * @return error code. 0 if no error
+   */
+  RC prefetch(const RecordId* rids, int n) const;
+
+  /**
+   * tell the OS how the records of the file are going to be read
+   * (see PageFile::advise()).
+   * @param advice[IN] the access pattern of the whole file
+   * @return error code. 0 if no error
+   */
+  RC advise(PageFile::Advice advice) const;
+
   /**
    * append a new record at the end of the file.
    * note that RecordFile does not have write() function.
@@ -96,9 +114,23 @@ class RecordFile {
    */
   const RecordId& endRid() const;
 
+  /**
+   * move a record id to the next record slot of the file.
+   * the number of slots per page depends on the page size of the file.
+   * @param rid[IN/OUT] the record id to advance
+   * @return rid
+   */
+  RecordId& advance(RecordId& rid) const;
+
+  /**
+   * @return # record slots per page of the file
+   */
+  int getRecordsPerPage() const { return slotsPerPage; }
+
  private:
   PageFile pf;     // the PageFile used to store the records
   RecordId erid;   // the last record id of the file + 1
+  int slotsPerPage; // # record slots per page
 };
 
 #endif // RECORDFILE_H
@@ -0,0 +1,153 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#include "ReplacementPolicy.h"
+
+using std::string;
+
+ReplacementPolicy* ReplacementPolicy::create(const string& name, int frameCount)
+{
+  if (name == "lru") return new LruPolicy(frameCount);
+  if (name == "2q") return new TwoQueuePolicy(frameCount);
+  return NULL;
+}
+
+
+FrameLists::FrameLists(int frameCount, int listCount)
+  : prev(frameCount, -1), next(frameCount, -1), owner(frameCount, -1),
+    heads(listCount, -1), tails(listCount, -1)
+{
+}
+
+void FrameLists::pushFront(int list, int f)
+{
+  unlink(f);
+  owner[f] = list;
+  prev[f] = -1;
+  next[f] = heads[list];
+  if (heads[list] >= 0) prev[heads[list]] = f;
+  heads[list] = f;
+  if (tails[list] < 0) tails[list] = f;
+}
+
+void FrameLists::unlink(int f)
+{
+  int list = owner[f];
+  if (list < 0) return;
+
+  if (prev[f] >= 0) next[prev[f]] = next[f];
+  else heads[list] = next[f];
+  if (next[f] >= 0) prev[next[f]] = prev[f];
+  else tails[list] = prev[f];
+
+  owner[f] = prev[f] = next[f] = -1;
+}
+
+
+LruPolicy::LruPolicy(int frameCount)
+  : lru(frameCount, 1)
+{
+}
+
+
+TwoQueuePolicy::TwoQueuePolicy(int frameCount)
+  : lists(frameCount, 2), queue(frameCount, NONE), key(frameCount, 0),
+    refTime(frameCount, -1)
+{
+  a1inCount = 0;
+  a1inMax = frameCount / 4;
+  if (a1inMax < 1) a1inMax = 1;
+  a1outMax = frameCount / 2;
+  clock = 0;
+  lastUsed = -1;
+}
+
+long TwoQueuePolicy::touch(int f)
+{
+  if (f != lastUsed) {
+    clock++;
+    lastUsed = f;
+  }
+  return clock;
+}
+
+void TwoQueuePolicy::loaded(int f, uint64_t page, bool referenced)
+{
+  std::unordered_map<uint64_t, std::list<uint64_t>::iterator>::iterator it;
+
+  key[f] = page;
+
+  // a page seen recently (in A1out) is hot; anything else starts in A1in
+  if ((it = a1outIndex.find(page)) != a1outIndex.end()) {
+    a1out.erase(it->second);
+    a1outIndex.erase(it);
+    queue[f] = AM;
+  } else {
+    queue[f] = A1IN;
+    a1inCount++;
+  }
+  refTime[f] = referenced ? touch(f) : -1;
+}
+
+void TwoQueuePolicy::pinned(int f)
+{
+  long now = touch(f);
+
+  lists.unlink(f);
+  if (queue[f] != A1IN) return;
+
+  // the first use of a page read ahead starts its reference period.
+  // a use after the period moves the page to Am.
+  if (refTime[f] < 0) {
+    refTime[f] = now;
+  } else if (now - refTime[f] > a1inMax) {
+    queue[f] = AM;
+    a1inCount--;
+  }
+}
+
+void TwoQueuePolicy::unpinned(int f)
+{
+  if (queue[f] != NONE) lists.pushFront(queue[f], f);
+}
+
+int TwoQueuePolicy::victim()
+{
+  int f;
+
+  // evict from A1in while it is larger than its share,
+  // and from Am otherwise (or whichever list is not empty)
+  if (a1inCount > a1inMax && (f = lists.tail(A1IN)) >= 0) return f;
+  if ((f = lists.tail(AM)) >= 0) return f;
+  return lists.tail(A1IN);
+}
+
+void TwoQueuePolicy::evicted(int f)
+{
+  // remember the pages evicted from A1in
+  if (queue[f] == A1IN) {
+    a1out.push_front(key[f]);
+    a1outIndex[key[f]] = a1out.begin();
+    if ((int)a1out.size() > a1outMax) {
+      a1outIndex.erase(a1out.back());
+      a1out.pop_back();
+    }
+  }
+  forget(f);
+}
+
+void TwoQueuePolicy::dropped(int f)
+{
+  forget(f);
+}
+
+void TwoQueuePolicy::forget(int f)
+{
+  lists.unlink(f);
+  if (queue[f] == A1IN) a1inCount--;
+  queue[f] = NONE;
+}
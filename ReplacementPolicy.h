@@ -0,0 +1,174 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#ifndef REPLACEMENTPOLICY_H
+#define REPLACEMENTPOLICY_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+/**
+ * decides which frame of a BufferPool is reused when a page that is not
+ * cached has to be read. frames are numbered from 0 to (# frames - 1),
+ * and a page is identified by a 64-bit key computed by the pool.
+ * the pool tells the policy about every change of a frame; only frames
+ * that hold a page and are not pinned may be chosen as a victim.
+ * the functions are called with the pool latch held, so a policy needs
+ * no locking of its own.
+ */
+class ReplacementPolicy {
+ public:
+  virtual ~ReplacementPolicy() {}
+
+  /**
+   * a page was brought into the frame. the frame is pinned.
+   * @param f[IN] the frame
+   * @param page[IN] the key of the page
+   * @param referenced[IN] true if the page is being used, false if it
+   *                       is read ahead of its use
+   */
+  virtual void loaded(int f, uint64_t page, bool referenced) = 0;
+
+  /**
+   * the first pin was taken on a frame that holds a page.
+   * @param f[IN] the frame
+   */
+  virtual void pinned(int f) = 0;
+
+  /**
+   * the last pin on a frame was released.
+   * @param f[IN] the frame
+   */
+  virtual void unpinned(int f) = 0;
+
+  /**
+   * the page of the frame was evicted to make room for another page.
+   * @param f[IN] the frame returned by victim()
+   */
+  virtual void evicted(int f) = 0;
+
+  /**
+   * the page of the frame was dropped (e.g., its file was closed).
+   * unlike evicted(), this says nothing about the page.
+   * @param f[IN] the frame
+   */
+  virtual void dropped(int f) = 0;
+
+  /**
+   * choose the frame whose page is evicted next. the choice takes
+   * effect when the pool calls evicted().
+   * @return the frame. -1 if every frame is pinned
+   */
+  virtual int victim() = 0;
+
+  /**
+   * @return the name of the policy
+   */
+  virtual const char* getName() const = 0;
+
+  /**
+   * create a policy by name. the names are
+   *   lru  - least recently used
+   *   2q   - 2Q (Johnson and Shasha, VLDB 1994), which keeps pages that
+   *          were read only once (e.g., by a table scan) from evicting
+   *          pages that are used again and again (e.g., index nodes)
+   * @param name[IN] the name of the policy
+   * @param frameCount[IN] # frames of the pool
+   * @return the new policy. NULL if there is no policy of the name
+   */
+  static ReplacementPolicy* create(const std::string& name, int frameCount);
+};
+
+/**
+ * frame lists linked through arrays indexed by frame number.
+ * a frame is in at most one of the lists at a time.
+ */
+class FrameLists {
+ public:
+  FrameLists(int frameCount, int listCount);
+
+  void pushFront(int list, int f);  // f becomes the head of the list
+  void unlink(int f);               // take f out of its list, if any
+  int  tail(int list) const { return tails[list]; }
+  int  listOf(int f) const { return owner[f]; }  // -1 if in no list
+
+ private:
+  std::vector<int> prev, next, owner;
+  std::vector<int> heads, tails;
+};
+
+/**
+ * least recently used: the unpinned frame whose last pin was released
+ * longest ago is evicted.
+ */
+class LruPolicy : public ReplacementPolicy {
+ public:
+  LruPolicy(int frameCount);
+
+  void loaded(int, uint64_t, bool) {}
+  void pinned(int f)   { lru.unlink(f); }
+  void unpinned(int f) { lru.pushFront(0, f); }
+  void evicted(int f)  { lru.unlink(f); }
+  void dropped(int f)  { lru.unlink(f); }
+  int  victim()        { return lru.tail(0); }
+  const char* getName() const { return "lru"; }
+
+ private:
+  FrameLists lru;
+};
+
+/**
+ * 2Q. a page read for the first time enters A1in, which is evicted
+ * first once it grows beyond a quarter of the frames. the keys of pages
+ * evicted from A1in are remembered in A1out (up to half as many keys as
+ * frames). a page read again while its key is in A1out has been used
+ * twice within a short time, and enters Am, which is evicted in LRU
+ * order only when A1in is small.
+ * a page of A1in is also moved to Am when it is used again after a
+ * "correlated reference period" (as in LRU-K): the repeated pins of a
+ * page by a scan, one per tuple, do not count as reuse, but the pins of
+ * the root of an index by every lookup do. time is counted in switches
+ * from one page to another, and the period is a quarter of the frames.
+ */
+class TwoQueuePolicy : public ReplacementPolicy {
+ public:
+  TwoQueuePolicy(int frameCount);
+
+  void loaded(int f, uint64_t page, bool referenced);
+  void pinned(int f);
+  void unpinned(int f);
+  void evicted(int f);
+  void dropped(int f);
+  int  victim();
+  const char* getName() const { return "2q"; }
+
+ private:
+  enum { NONE = -1, A1IN = 0, AM = 1 };
+
+  FrameLists lists;          // the unpinned frames of A1in and Am
+  std::vector<int> queue;    // the queue of each frame (NONE, A1IN, AM)
+  std::vector<uint64_t> key; // the page of each frame
+  int a1inCount;             // # frames in A1in, including pinned ones
+  int a1inMax;               // the target size of A1in
+  int a1outMax;              // # keys kept in A1out
+
+  std::vector<long> refTime; // when a frame of A1in was first used.
+                             //   -1 if it was read ahead and not used
+  long clock;                // # switches between pages so far
+  int  lastUsed;             // the frame used last
+
+  std::list<uint64_t> a1out; // A1out, newest key first
+  std::unordered_map<uint64_t, std::list<uint64_t>::iterator> a1outIndex;
+
+  long touch(int f);
+  void forget(int f);
+};
+
+#endif // REPLACEMENTPOLICY_H
@@ -10,8 +10,13 @@
 #include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Bruinbase.h"
 #include "SqlEngine.h"
+#include "BufferPool.h"
+#include "IOStats.h"
+#include "WriteAheadLog.h"
 
 using namespace std;
 
@@ -19,6 +24,47 @@ using namespace std;
 extern FILE* sqlin;
 int sqlparse(void);
 
+// PageFile open options used by SELECT for the table and index files,
+// and by both SELECT and LOAD (see SqlEngine::set())
+static int selectFlags = 0;
+static int fileFlags = 0;
+
+// BTreeIndex open options used by LOAD for new indexes
+static int indexFlags = 0;
+
+// true if SELECT and LOAD tell the OS how they read files
+// (see PageFile::advise())
+static bool accessHints = true;
+
+// # index entries whose tuples are read ahead at a time by SELECT
+static const int PREFETCH_WINDOW = 32;
+
+// drop the input of LOAD from the OS page cache, since it is read only
+// once. the page cache is shared by every descriptor of the file, so a
+// descriptor of our own does.
+static void dropInput(const string& loadfile)
+{
+  int fd = ::open(loadfile.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+}
+
+// start reading the table pages of the tuples of the next
+// (2 * PREFETCH_WINDOW) index entries from cursor, but not beyond end
+static void prefetchTuples(BTreeIndex& index, const RecordFile& rf,
+                           IndexCursor cursor, const IndexCursor& end)
+{
+  RecordId rids[2 * PREFETCH_WINDOW];
+  int n, key;
+
+  for (n = 0; n < 2 * PREFETCH_WINDOW; n++) {
+    if (cursor.pid <= 0 || (cursor.pid == end.pid && cursor.eid == end.eid)) break;
+    if (index.readForward(cursor, key, rids[n]) < 0) break;
+  }
+  rf.prefetch(rids, n);
+}
+
 
 RC SqlEngine::run(FILE* commandline)
 {
@@ -52,13 +98,13 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
     vector<bool> checked;
     
     // open the table file
-    if ((rc = rf.open(table + ".tbl", 'r')) < 0) {
+    if ((rc = rf.open(table + ".tbl", 'r', selectFlags | fileFlags)) < 0) {
         fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
         return rc;
     }
     
     
-    if((rc = Bindex.open(table + ".idx",'r')) < 0){
+    if((rc = Bindex.open(table + ".idx",'r', selectFlags | fileFlags)) < 0){
         //fprintf(stderr, "Error: indextable %s does not exist\n", table.c_str());
         noindex = true;
     }
@@ -69,9 +115,19 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
     cursor.pid = 1;
     cursor.eid = 0;
     IndexCursor nexttarget;
-    IndexCursor Cbegin;
-    Cbegin.pid = 1;
-    Cbegin.eid = 0;
+    // the first entry of the index is in page 1, unless the index is
+    // shadow-paged (see BTreeIndex::SHADOW)
+    IndexCursor first;
+    first.pid = 1;
+    first.eid = 0;
+    if (!noindex && Bindex.isShadow()) {
+      // locate() fails unless the key is found, but sets the cursor
+      IndexCursor located;
+      located.pid = 0;
+      Bindex.locate(INT_MIN, located);
+      if (located.pid > 0) first = located;
+    }
+    IndexCursor Cbegin = first;
     IndexCursor Cend;
     Cend.pid = 0;
     Cend.eid = 0;
@@ -146,7 +202,7 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
                     Cend = target;
                     if(target.pid == 1&& target.eid == 0)
                         nosuchvalue = true;
-                    fprintf(stdout, " Cend.pid: %d Cend.eid: %d\n", Cend.pid, Cend.eid);
+                    fprintf(stdout, " Cend.pid: %lld Cend.eid: %d\n", Cend.pid, Cend.eid);
                     Kmax =min(Kmax, condval-1);
                 }
                     break;
@@ -166,7 +222,7 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
                     if(condval>=Kmax)
                         break;
                     Cend = (found < 0) ? target : nexttarget;
-                    if(found == RC_NO_SUCH_RECORD && target.pid == 1&& target.eid == 0)
+                    if(found == RC_NO_SUCH_RECORD && target.pid == first.pid && target.eid == first.eid)
                         nosuchvalue = true;
                     Kmax = min(Kmax, condval);
                 }
@@ -217,11 +273,26 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         }
     }
     
+    // the tuples are read in order by a scan, or scattered through the
+    // index (whose pages are read ahead by prefetchTuples() instead of
+    // the kernel)
+    if (accessHints && (attr == 2 || attr == 3 || readRF)) {
+        rf.advise(useindex ? PageFile::ADVISE_RANDOM : PageFile::ADVISE_SEQUENTIAL);
+    }
+
+    int ahead = 0;
     while ( rid < rf.endRid()) {
 
         // read the tuple
       
         if(attr == 2 || attr == 3 || readRF){
+            // tuples found through the index are scattered over the table;
+            // read their pages ahead in a batch
+            if(useindex && --ahead <= 0){
+                prefetchTuples(Bindex, rf, cursor, Cend);
+                ahead = PREFETCH_WINDOW;
+            }
+
             if ((rc = rf.read(rid, key, value)) < 0) {
                 fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
                 goto exit_select;
@@ -324,7 +395,7 @@ RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
         Bindex.readForward(cursor, key, rid);
         }
         if(!useindex)
-        ++rid;
+        rf.advance(rid);
         //fprintf(stdout, "%d %d\n", cursor.pid, cursor.eid);
         //fprintf(stdout, "%d %d\n", rid.pid, rid.sid);
       
@@ -360,13 +431,14 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
   string value;
   
   //open the table file
-  if((rc = rf.open(table + ".tbl", 'w')) < 0) {
+  // pages are written back when the files are closed, not on every append
+  if((rc = rf.open(table + ".tbl", 'w', PageFile::WRITE_BACK | fileFlags)) < 0) {
     fprintf(stderr, "Error: could not open table %s, error code: %d\n", table.c_str(), rc);
     return rc;
     }
     if(index == true){
         //fprintf(stdout, "USING INDEX");
-        if(rc =Bindex.open(table + ".idx", 'w') < 0){
+        if((rc = Bindex.open(table + ".idx", 'w', PageFile::WRITE_BACK | fileFlags | indexFlags)) < 0){
             fprintf(stderr, "Error: could not open indextable %s, error code: %d\n", table.c_str(), rc);
             return rc;
 
@@ -383,16 +455,255 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
       fprintf(stderr, "Error: could not load tuple (%d, %s), error code : %d\n", key, value.c_str(), rc);
       return rc;
     }
-      if(index == true)
-          Bindex.insert(key, rid);
+      if(index == true && (rc = Bindex.insert(key, rid)) < 0) {
+        fprintf(stderr, "Error: could not index tuple (%d, %s), error code : %d\n", key, value.c_str(), rc);
+        break;
+      }
           
   }
-  rc = 0;
-  rf.close();
-  Bindex.close();
+  infile.close();
+  if (accessHints) dropInput(loadfile);
+
+  // a logged LOAD is durable once the log is. a failed one is not
+  // committed, so that it does not pass for complete.
+  if (rc >= 0) {
+    rc = 0;
+    if ((fileFlags & PageFile::LOGGED) && (rc = WriteAheadLog::commit()) < 0) {
+      fprintf(stderr, "Error: could not commit the load of %s, error code: %d\n", table.c_str(), rc);
+    }
+  }
+
+  // the pages still in the buffer pool are written by close()
+  RC closeRc = rf.close();
+  if (rc == 0) rc = closeRc;
+  if (index) {
+    closeRc = Bindex.close();
+    if (rc == 0) rc = closeRc;
+  }
+  if (rc < 0) fprintf(stderr, "Error: could not close the files of %s, error code: %d\n", table.c_str(), rc);
   return rc;
 }
 
+RC SqlEngine::set(const string& name, int value)
+{
+  RC rc;
+
+  if (name == "buffer_pool_pages") {
+    if ((rc = BufferPool::setPoolSize(value)) < 0) {
+      fprintf(stderr, "Error: buffer_pool_pages must be at least %d\n", BufferPool::MIN_FRAME_COUNT);
+      return rc;
+    }
+    return 0;
+  }
+
+  if (name == "compressed_cache_bytes") {
+    if (value < 0) {
+      fprintf(stderr, "Error: compressed_cache_bytes must not be negative\n");
+      return RC_INVALID_ATTRIBUTE;
+    }
+    BufferPool::setCompressedSize(value);
+    return 0;
+  }
+
+  if (name == "write_run_pages") {
+    if (value < 1 || value > BufferPool::MAX_WRITE_RUN) {
+      fprintf(stderr, "Error: write_run_pages must be from 1 to %d\n", BufferPool::MAX_WRITE_RUN);
+      return RC_INVALID_ATTRIBUTE;
+    }
+    BufferPool::setWriteRun(value);
+    return 0;
+  }
+
+  if (name == "writer_interval_ms") {
+    if (value < 0) {
+      fprintf(stderr, "Error: writer_interval_ms must not be negative\n");
+      return RC_INVALID_ATTRIBUTE;
+    }
+    BufferPool::setWriterInterval(value);
+    return 0;
+  }
+
+  if (name == "checkpoint_interval_ms") {
+    if (value < 0) {
+      fprintf(stderr, "Error: checkpoint_interval_ms must not be negative\n");
+      return RC_INVALID_ATTRIBUTE;
+    }
+    BufferPool::setCheckpointInterval(value);
+    return 0;
+  }
+
+  if (name == "huge_pages") {
+    if ((rc = BufferPool::setHugePages(value != 0)) < 0) {
+      fprintf(stderr, "Error: the buffer pool is in use\n");
+      return rc;
+    }
+    return 0;
+  }
+
+  if (name == "page_size") {
+    if ((rc = PageFile::setCreatePageSize(value)) < 0) {
+      fprintf(stderr, "Error: page_size must be a power of two from %d to %d\n",
+              PageFile::PAGE_SIZE, PageFile::MAX_PAGE_SIZE);
+      return rc;
+    }
+    return 0;
+  }
+
+  if (name == "readahead_pages") {
+    if (value < 0) {
+      fprintf(stderr, "Error: readahead_pages must not be negative\n");
+      return RC_INVALID_ATTRIBUTE;
+    }
+    PageFile::setReadahead(value);
+    return 0;
+  }
+
+  if (name == "prealloc_pages") {
+    if (value < 0) {
+      fprintf(stderr, "Error: prealloc_pages must not be negative\n");
+      return RC_INVALID_ATTRIBUTE;
+    }
+    PageFile::setGrowthStep(value);
+    if (value) fileFlags |= PageFile::PREALLOCATE;
+    else fileFlags &= ~PageFile::PREALLOCATE;
+    return 0;
+  }
+
+  if (name == "warmup_pages") {
+    if (value < 0) {
+      fprintf(stderr, "Error: warmup_pages must not be negative\n");
+      return RC_INVALID_ATTRIBUTE;
+    }
+    PageFile::setWarmup(value);
+    return 0;
+  }
+
+  if (name == "direct_io") {
+    if (value) fileFlags |= PageFile::DIRECT;
+    else fileFlags &= ~PageFile::DIRECT;
+    return 0;
+  }
+
+  if (name == "index_pin_budget") {
+    if (value < 0) {
+      fprintf(stderr, "Error: index_pin_budget must not be negative\n");
+      return RC_INVALID_ATTRIBUTE;
+    }
+    BTreeIndex::setPinBudget(value);
+    return 0;
+  }
+
+  if (name == "page_checksums") {
+    if (value) fileFlags |= PageFile::CHECKSUM;
+    else fileFlags &= ~PageFile::CHECKSUM;
+    return 0;
+  }
+
+  if (name == "shadow_indexes") {
+    if (value) indexFlags |= BTreeIndex::SHADOW;
+    else indexFlags &= ~BTreeIndex::SHADOW;
+    return 0;
+  }
+
+  if (name == "write_ahead_log") {
+    if (value) {
+      if (!WriteAheadLog::isOpen() && (rc = WriteAheadLog::open(WriteAheadLog::DEFAULT_NAME)) < 0) {
+        fprintf(stderr, "Error: could not open the log %s\n", WriteAheadLog::DEFAULT_NAME);
+        return rc;
+      }
+      fileFlags |= PageFile::LOGGED;
+    } else {
+      if ((rc = WriteAheadLog::close()) < 0) {
+        fprintf(stderr, "Error: could not close the log %s\n", WriteAheadLog::DEFAULT_NAME);
+        return rc;
+      }
+      fileFlags &= ~PageFile::LOGGED;
+    }
+    return 0;
+  }
+
+  if (name == "access_hints") {
+    accessHints = (value != 0);
+    return 0;
+  }
+
+  if (name == "mmap_tables") {
+    if (value) selectFlags |= PageFile::MMAP;
+    else selectFlags &= ~PageFile::MMAP;
+    return 0;
+  }
+
+  fprintf(stderr, "Error: unknown setting %s\n", name.c_str());
+  return RC_INVALID_ATTRIBUTE;
+}
+
+RC SqlEngine::set(const string& name, const string& value)
+{
+  RC rc;
+
+  if (name == "replacement_policy") {
+    if ((rc = BufferPool::setPolicy(value)) < 0) {
+      fprintf(stderr, "Error: replacement_policy must be lru or 2q\n");
+      return rc;
+    }
+    return 0;
+  }
+
+  fprintf(stderr, "Error: unknown setting %s\n", name.c_str());
+  return RC_INVALID_ATTRIBUTE;
+}
+
+// print the non-empty buckets of a latency histogram of IOStats
+static void printLatency(const char* label, const std::atomic<long long>* buckets)
+{
+  bool empty = true;
+
+  for (int i = 0; i < IOStats::LATENCY_BUCKETS; i++) {
+    long long n = buckets[i].load();
+    if (n == 0) continue;
+    if (empty) fprintf(stdout, "    %s latency (usec):", label);
+    empty = false;
+    fprintf(stdout, "  <%lld: %lld", 1LL << i, n);
+  }
+  if (!empty) fprintf(stdout, "\n");
+}
+
+// print a row of I/O statistics and its latency histograms
+static void printIOStats(const string& name, const IOStats* stats)
+{
+  long long calls = stats->writeCalls.load();
+
+  fprintf(stdout, "  %-24s %10lld %10lld %10lld %10lld %10lld %10lld %10lld\n", name.c_str(),
+          stats->reads.load(), stats->writes.load(), stats->hits.load(),
+          stats->misses.load(), stats->tierHits.load(), stats->evictions.load(),
+          (calls > 0) ? stats->writeBytes.load() / calls : 0LL);
+  printLatency("read", stats->readLatency);
+  printLatency("write", stats->writeLatency);
+}
+
+RC SqlEngine::show(const string& what)
+{
+  if (what == "io stats") {
+    vector<pair<string, IOStats*> > files, threads;
+    IOStats::list(files, threads);
+
+    fprintf(stdout, "  %-24s %10s %10s %10s %10s %10s %10s %10s\n", "file",
+            "reads", "writes", "hits", "misses", "tier hits", "evictions", "avg write");
+    for (unsigned i = 0; i < files.size(); i++) printIOStats(files[i].first, files[i].second);
+    fprintf(stdout, "  %-24s %10s %10s %10s %10s %10s %10s %10s\n", "thread",
+            "reads", "writes", "hits", "misses", "tier hits", "evictions", "avg write");
+    for (unsigned i = 0; i < threads.size(); i++) printIOStats(threads[i].first, threads[i].second);
+    if (WriteAheadLog::getCommitCount() > 0) {
+      fprintf(stdout, "  log: %lld commits, %lld syncs\n",
+              WriteAheadLog::getCommitCount(), WriteAheadLog::getSyncCount());
+    }
+    return 0;
+  }
+
+  fprintf(stderr, "Error: unknown SHOW command %s\n", what.c_str());
+  return RC_INVALID_ATTRIBUTE;
+}
+
 RC SqlEngine::parseLoadLine(const string& line, int& key, string& value)
 {
     const char *s;
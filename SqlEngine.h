@@ -60,6 +60,94 @@ class SqlEngine {
    */
   static RC load(const std::string& table, const std::string& loadfile, bool index);
 
+  /**
+   * change a run-time setting of the engine (the SET command).
+   * currently supported settings:
+   *   buffer_pool_pages - the number of page frames in the buffer pool
+   *                       (of each page size)
+   *   compressed_cache_bytes - the memory in bytes for keeping pages
+   *                       evicted from the buffer pool compressed (of
+   *                       each page size; BufferPool::setCompressedSize()).
+   *                       0 disables it
+   *   write_run_pages   - the longest run of consecutive dirty pages
+   *                       written with a single I/O when the buffer pool
+   *                       is flushed (BufferPool::setWriteRun(), 1 to
+   *                       1024). 1 disables coalescing
+   *   writer_interval_ms - the time between two rounds of the background
+   *                       writer that writes the oldest dirty pages of
+   *                       the buffer pool (BufferPool::setWriterInterval()).
+   *                       0 stops it
+   *   checkpoint_interval_ms - the time between two checkpoints of the
+   *                       indexes being written (BTreeIndex::checkpoint()).
+   *                       0 stops them
+   *   huge_pages        - 1 to back the buffer pool with 2MB huge pages
+   *                       (BufferPool::setHugePages(), also the -H
+   *                       startup option), 0 not to
+   *   page_size         - the page size in bytes of the table and index
+   *                       files created from now on (1024 to 16384)
+   *   mmap_tables       - 1 to read tables and indexes in SELECT through
+   *                       memory-mapped files (PageFile::MMAP), 0 not to
+   *   direct_io         - 1 to access tables and indexes with direct I/O
+   *                       (PageFile::DIRECT), bypassing the OS page cache
+   *   page_checksums    - 1 to create table and index files whose pages
+   *                       carry a CRC32C checksum (PageFile::CHECKSUM)
+   *   readahead_pages   - the readahead window of sequential scans in
+   *                       pages. 0 disables readahead
+   *   prealloc_pages    - # pages of disk space allocated at a time for
+   *                       growing table and index files
+   *                       (PageFile::PREALLOCATE). 0 disables it
+   *   warmup_pages      - # hottest buffer pool pages of a table or index
+   *                       remembered when it is closed, and prefetched
+   *                       when the next run first opens it
+   *                       (PageFile::setWarmup(), also the -w startup
+   *                       option). 0 disables warm-up
+   *   index_pin_budget  - the memory in bytes for keeping the non-leaf
+   *                       nodes of open indexes pinned in the buffer
+   *                       pool (see BTreeIndex::setPinBudget()). 0
+   *                       disables pinning
+   *   shadow_indexes    - 1 to create the indexes of LOAD with shadow
+   *                       paging (BTreeIndex::SHADOW), so that a crash
+   *                       leaves an index as of its last commit. 0 not to
+   *   access_hints      - 1 (the default) to tell the OS how SELECT
+   *                       reads tables (sequentially for a scan, randomly
+   *                       through an index) and that the input of LOAD is
+   *                       not needed again (PageFile::advise()), 0 not to
+   *   write_ahead_log   - 1 to log the pages of the tables and indexes
+   *                       opened for writing from now on, and make each
+   *                       LOAD durable through the log (see
+   *                       WriteAheadLog.h, PageFile::LOGGED). 0 syncs
+   *                       the logged files and removes the log
+   * @param name[IN] the name of the setting
+   * @param value[IN] the new value of the setting
+   * @return error code. 0 if no error
+   */
+  static RC set(const std::string& name, int value);
+
+  /**
+   * change a run-time setting whose value is a word (the SET command).
+   * currently supported settings:
+   *   replacement_policy - the page replacement policy of the buffer
+   *                        pool: lru, or 2q (scan resistant; write it
+   *                        quoted, i.e., '2q')
+   * @param name[IN] the name of the setting
+   * @param value[IN] the new value of the setting
+   * @return error code. 0 if no error
+   */
+  static RC set(const std::string& name, const std::string& value);
+
+  /**
+   * print information about the engine (the SHOW command).
+   * currently supported:
+   *   io stats - the page reads and writes, buffer pool hits, misses
+   *              (and those served by the compressed tier),
+   *              evictions and the average write size in bytes, and
+   *              read/write latency histograms of
+   *              every file and thread so far (see IOStats.h)
+   * @param what[IN] the words after SHOW, separated by a space
+   * @return error code. 0 if no error
+   */
+  static RC show(const std::string& what);
+
   /**
    * parse a line from the load file into the (key, value) pair.
    * @param line[IN] a line from a load file
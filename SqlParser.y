@@ -1,12 +1,15 @@
 %{
 #include <cstdio>
 #include <cstring>
+#include <cstdlib>
 #include <sys/times.h>
+#include <unistd.h>
 #include <climits>
 #include <string>
 #include "Bruinbase.h"
 #include "SqlEngine.h" 
 #include "PageFile.h"
+#include "BufferPool.h"
 
 int  sqllex(void);  
 void sqlerror(const char *str) { fprintf(stderr, "Error: %s\n", str); }
@@ -16,15 +19,20 @@ static void runSelect(int attr, const char* table, const std::vector<SelCond>& c
 {
   struct tms tmsbuf;
   clock_t btime, etime;
-  int     bpagecnt, epagecnt;
+  long long bpagecnt, epagecnt;
+  long long bhitcnt, ehitcnt, bmisscnt, emisscnt;
 
   btime = times(&tmsbuf);
   bpagecnt = PageFile::getPageReadCount();
+  bhitcnt = BufferPool::getHitCount();
+  bmisscnt = BufferPool::getMissCount();
   SqlEngine::select(attr, table, conds);
   etime = times(&tmsbuf);
   epagecnt = PageFile::getPageReadCount();
+  ehitcnt = BufferPool::getHitCount();
+  emisscnt = BufferPool::getMissCount();
 
-  fprintf(stderr, "  -- %.3f seconds to run the select command. Read %d pages\n", ((float)(etime - btime))/sysconf(_SC_CLK_TCK), epagecnt - bpagecnt);
+  fprintf(stderr, "  -- %.3f seconds to run the select command. Read %lld pages (buffer pool: %lld hits, %lld misses)\n", ((float)(etime - btime))/sysconf(_SC_CLK_TCK), epagecnt - bpagecnt, ehitcnt - bhitcnt, emisscnt - bmisscnt);
 }
 
 %}
@@ -42,7 +50,7 @@ static void runSelect(int attr, const char* table, const std::vector<SelCond>& c
 %token EQUAL NEQUAL LESS LESSEQUAL GREATER GREATEREQUAL 
 
 %type <integer> attributes attribute comparator
-%type <string> table value
+%type <string> table value word
 %type <cond> condition
 %type <conds> conditions
 %%
@@ -55,6 +63,7 @@ commands:
 command:
         load_command { fprintf(stdout, "Bruinbase> "); }
 	| select_command { fprintf(stdout, "Bruinbase> "); }
+	| set_command { fprintf(stdout, "Bruinbase> "); }
 	| quit_command
 	| error LF { fprintf(stdout, "Bruinbase> "); }
 	| LF { fprintf(stdout, "Bruinbase> "); }
@@ -77,6 +86,24 @@ load_command:
 	}
 	;
 
+set_command:
+	ID ID INTEGER LF {
+	  if (strcasecmp($1, "set") == 0) SqlEngine::set(std::string($2), atoi($3));
+	  else sqlerror("unknown command");
+	  free($1);
+	  free($2);
+	  free($3);
+	}
+	| ID ID word LF {
+	  if (strcasecmp($1, "set") == 0) SqlEngine::set(std::string($2), std::string($3));
+	  else if (strcasecmp($1, "show") == 0) SqlEngine::show(std::string($2) + " " + $3);
+	  else sqlerror("unknown command");
+	  free($1);
+	  free($2);
+	  free($3);
+	}
+	;
+
 select_command:
 	SELECT attributes FROM table LF {
    	        std::vector<SelCond> conds;
@@ -140,6 +167,11 @@ table:
 	ID { $$ = $1; }
 	;
 
+word:
+	ID       { $$ = $1; }
+	| STRING { $$ = $1; }
+	;
+
 comparator:
 	EQUAL          { $$ = SelCond::EQ; }
 	| NEQUAL       { $$ = SelCond::NE; }
@@ -0,0 +1,568 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "WriteAheadLog.h"
+#include "Checksum.h"
+#include "IOStats.h"
+
+const char* const WriteAheadLog::DEFAULT_NAME = "bruinbase.wal";
+
+static const uint32_t LOG_MAGIC = 0x4C415742;  // "BWAL" on little-endian
+static const uint32_t MAX_RECORD = 2 * PageFile::MAX_PAGE_SIZE;
+
+// the types of records
+enum { PAGE_RECORD = 1, COMMIT_RECORD = 2, UNDO_RECORD = 3 };
+
+// the header of every record in the log
+struct LogHeader {
+  uint32_t magic;   // LOG_MAGIC
+  uint32_t type;    // PAGE_RECORD or COMMIT_RECORD
+  uint32_t length;  // # bytes of the record after the header
+  uint32_t crc;     // CRC32C of the header (with crc 0) and the record
+  int64_t  lsn;     // the position of the end of the record
+};
+
+// a PAGE_RECORD, followed by the name of the file and the page
+struct PageRecord {
+  int64_t pid;        // the page
+  int32_t pageSize;   // the page size of the file
+  int32_t flags;      // PageFile::CHECKSUM if the file has checksums
+  int32_t nameLength; // # bytes of the name
+  int32_t dataSize;   // # bytes of the page
+};
+
+// an UNDO_RECORD, followed by the name of the file and the old content of
+// the page on the disk (none if the page was past the end of the file)
+struct UndoRecord {
+  int64_t pid;        // the page
+  int64_t offset;     // the file offset of the page (the file length if none)
+  int32_t nameLength; // # bytes of the name
+  int32_t dataSize;   // # bytes of the content. 0 to truncate at offset
+};
+
+// the pages of a file changed since the last commit
+struct Changes {
+  std::map<PageId, bool> pages;  // true once the old content is logged
+  off_t end;                     // the file is truncated here on undo. -1 if not
+
+  Changes() : end(-1) {}
+};
+
+// the state of the log. positions (LSNs) count the bytes appended since
+// the log was opened, and are not reset when the log is emptied. like the
+// I/O engine, it is never deleted, since the background writer may flush
+// pages (and so the log) while the process exits.
+struct LogState {
+  std::mutex latch;               // protects the members below
+  std::condition_variable synced; // signaled when a sync ends
+  std::string name;               // the name of the log
+  int  fd;                        // the log. -1 if not open
+  std::vector<char> buffer;       // the records not yet written
+  long long bufferStart;          // the position of buffer[0]
+  long long base;                 // the position of offset 0 of the log
+  long long durable;              // the records before are on the disk
+  bool syncing;                   // true while a thread syncs the log
+  bool failed;                    // true once a write of the log failed
+  int  openFiles;                 // # logged files open
+  std::set<std::string> files;    // the files with records in the log
+  std::map<std::string, Changes> changes;  // the changes since the last commit
+  long long commits;              // # commit() calls
+  long long syncs;                // # fdatasync of the log
+  IOStats* stats;                 // the I/O statistics of the log
+
+  LogState() : fd(-1), bufferStart(0), base(0), durable(0), syncing(false),
+               failed(false), openFiles(0), commits(0), syncs(0), stats(NULL) {}
+};
+
+static LogState& state()
+{
+  static LogState* log = new LogState;
+  return *log;
+}
+
+// append a record made of parts to the buffer and return its position
+static long long append(LogState& s, uint32_t type, const struct iovec* parts, int n)
+{
+  LogHeader header;
+  size_t start = s.buffer.size(), length = 0, offset = sizeof(header);
+
+  for (int i = 0; i < n; i++) length += parts[i].iov_len;
+  header.magic = LOG_MAGIC;
+  header.type = type;
+  header.length = (uint32_t)length;
+  header.crc = 0;
+  header.lsn = s.bufferStart + (long long)(start + sizeof(header) + length);
+
+  s.buffer.resize(start + sizeof(header) + length);
+  char* p = &s.buffer[start];
+  memcpy(p, &header, sizeof(header));
+  for (int i = 0; i < n; i++) {
+    memcpy(p + offset, parts[i].iov_base, parts[i].iov_len);
+    offset += parts[i].iov_len;
+  }
+  header.crc = crc32c(p, offset);
+  memcpy(p + offsetof(LogHeader, crc), &header.crc, sizeof(header.crc));
+
+  return header.lsn;
+}
+
+// write data to the log at a position, without syncing it
+static bool writeLog(LogState& s, const std::vector<char>& data, long long position)
+{
+  long long start = IOStats::now();
+  size_t done = 0;
+
+  while (done < data.size()) {
+    ssize_t n = ::pwrite(s.fd, &data[done], data.size() - done, (off_t)(position - s.base + done));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    done += n;
+  }
+  IOStats::countWrite(s.stats, IOStats::now() - start);
+  IOStats::countWriteCall(s.stats, data.size());
+  return true;
+}
+
+// read the record at a position of the log into record (header included).
+// last is the position of the end of the previous record (-1 if none).
+// return false if there is no complete and intact record there.
+static bool readRecord(int fd, off_t offset, long long last,
+                       LogHeader& header, std::vector<char>& record)
+{
+  if (::pread(fd, &header, sizeof(header), offset) != (ssize_t)sizeof(header)) return false;
+  if (header.magic != LOG_MAGIC || header.length > MAX_RECORD) return false;
+  if (last >= 0 && header.lsn != last + (long long)(sizeof(header) + header.length)) return false;
+
+  record.resize(sizeof(header) + header.length);
+  if (::pread(fd, &record[0], record.size(), offset) != (ssize_t)record.size()) return false;
+  memset(&record[offsetof(LogHeader, crc)], 0, sizeof(header.crc));
+  return crc32c(&record[0], record.size()) == header.crc;
+}
+
+// write back the old content of the pages recorded by the UNDO_RECORDs
+// after the last commit (the latest first), and cut the files back to
+// their length before it
+static RC undo(int fd, off_t committed, const std::vector<off_t>& undos, long long& pages)
+{
+  std::map<std::string, int> files;
+  std::map<std::string, off_t> ends;
+  std::vector<char> record;
+  LogHeader header;
+  UndoRecord undo;
+  RC rc = 0;
+
+  for (std::vector<off_t>::const_reverse_iterator it = undos.rbegin(); it != undos.rend() && *it >= committed; ++it) {
+    if (!readRecord(fd, *it, -1, header, record) || header.length < sizeof(undo)) {
+      rc = RC_INVALID_FILE_FORMAT;
+      break;
+    }
+    memcpy(&undo, &record[sizeof(header)], sizeof(undo));
+    if (undo.nameLength <= 0 || undo.dataSize < 0 || undo.offset < 0 ||
+        sizeof(undo) + undo.nameLength + undo.dataSize != header.length) {
+      rc = RC_INVALID_FILE_FORMAT;
+      break;
+    }
+    std::string file(&record[sizeof(header) + sizeof(undo)], undo.nameLength);
+
+    // a file removed since then has nothing to undo
+    std::map<std::string, int>::iterator f = files.find(file);
+    if (f == files.end()) {
+      f = files.insert(std::make_pair(file, ::open(file.c_str(), O_WRONLY))).first;
+      if (f->second < 0 && errno != ENOENT) {
+        rc = RC_FILE_OPEN_FAILED;
+        break;
+      }
+    }
+    if (f->second < 0) continue;
+
+    if (undo.dataSize == 0) {
+      std::map<std::string, off_t>::iterator e = ends.find(file);
+      if (e == ends.end() || (off_t)undo.offset < e->second) ends[file] = (off_t)undo.offset;
+      continue;
+    }
+    const char* data = &record[sizeof(header) + sizeof(undo) + undo.nameLength];
+    if (::pwrite(f->second, data, undo.dataSize, (off_t)undo.offset) != undo.dataSize) {
+      rc = RC_FILE_WRITE_FAILED;
+      break;
+    }
+    pages++;
+  }
+
+  // a file is only ever cut shorter
+  for (std::map<std::string, off_t>::iterator e = ends.begin(); rc == 0 && e != ends.end(); ++e) {
+    struct stat st;
+    int f = files[e->first];
+    if (f < 0) continue;
+    if (::fstat(f, &st) < 0 || (st.st_size > e->second && ::ftruncate(f, e->second) < 0)) rc = RC_FILE_WRITE_FAILED;
+  }
+
+  // the files must be on the disk before the log is gone
+  for (std::map<std::string, int>::iterator f = files.begin(); f != files.end(); ++f) {
+    if (f->second < 0) continue;
+    if (::fdatasync(f->second) < 0 && rc == 0) rc = RC_FILE_WRITE_FAILED;
+    ::close(f->second);
+  }
+  return rc;
+}
+
+// write the page of every PAGE_RECORD before the last commit to its file
+static RC redo(int fd, off_t committed, long long& pages)
+{
+  std::map<std::string, PageFile*> files;
+  std::vector<char> record;
+  LogHeader header;
+  PageRecord page;
+  off_t offset = 0;
+  int createSize = PageFile::getCreatePageSize();
+  RC rc = 0, r;
+
+  for (; offset < committed; offset += record.size()) {
+    if (!readRecord(fd, offset, -1, header, record)) {
+      rc = RC_INVALID_FILE_FORMAT;
+      break;
+    }
+    if (header.type != PAGE_RECORD) continue;
+
+    if (header.length < sizeof(page)) {
+      rc = RC_INVALID_FILE_FORMAT;
+      break;
+    }
+    memcpy(&page, &record[sizeof(header)], sizeof(page));
+    if (page.nameLength <= 0 || page.dataSize <= 0 || page.dataSize > page.pageSize ||
+        sizeof(page) + page.nameLength + page.dataSize != header.length) {
+      rc = RC_INVALID_FILE_FORMAT;
+      break;
+    }
+    std::string file(&record[sizeof(header) + sizeof(page)], page.nameLength);
+    const char* data = &record[sizeof(header) + sizeof(page) + page.nameLength];
+
+    // a file lost in the crash is created again
+    PageFile*& pf = files[file];
+    if (pf == NULL) {
+      PageFile::setCreatePageSize(page.pageSize);
+      pf = new PageFile;
+      if ((rc = pf->open(file, 'w', page.flags & PageFile::CHECKSUM)) < 0) break;
+    }
+    if (pf->getPageSize() != page.dataSize) {
+      rc = RC_INVALID_FILE_FORMAT;
+      break;
+    }
+    if ((rc = pf->write((PageId)page.pid, data)) < 0) break;
+    pages++;
+  }
+  PageFile::setCreatePageSize(createSize);
+
+  // the pages must be on the disk before the log is gone
+  for (std::map<std::string, PageFile*>::iterator it = files.begin(); it != files.end(); ++it) {
+    if ((r = it->second->sync()) < 0 && rc == 0) rc = r;
+    delete it->second;
+  }
+  return rc;
+}
+
+// write a full buffer to the log, without syncing it
+static RC spill(LogState& s)
+{
+  if (s.buffer.size() < WriteAheadLog::BUFFER_SIZE) return 0;
+  if (!writeLog(s, s.buffer, s.bufferStart)) {
+    s.failed = true;
+    return RC_FILE_WRITE_FAILED;
+  }
+  s.bufferStart += s.buffer.size();
+  s.buffer.clear();
+  return 0;
+}
+
+// make the pages of the logged files durable and empty the log.
+// called with the latch held when no logged file is open.
+static RC truncateLog(LogState& s, std::unique_lock<std::mutex>& lock)
+{
+  RC rc = 0;
+
+  while (s.syncing) s.synced.wait(lock);
+
+  // the pages must be on the disk before their records are gone
+  for (std::set<std::string>::iterator it = s.files.begin(); it != s.files.end(); ++it) {
+    int fd = ::open(it->c_str(), O_RDONLY);
+    if (fd < 0) continue;  // the file was removed
+    if (::fdatasync(fd) < 0) rc = RC_FILE_WRITE_FAILED;
+    ::close(fd);
+  }
+  if (rc < 0) return rc;
+  if (::ftruncate(s.fd, 0) < 0 || ::fdatasync(s.fd) < 0) return RC_FILE_WRITE_FAILED;
+
+  s.bufferStart += s.buffer.size();
+  s.buffer.clear();
+  s.base = s.durable = s.bufferStart;
+  s.files.clear();
+  s.changes.clear();
+  return 0;
+}
+
+// sync the directory of a file, so that a new file survives a crash
+static void syncDirectory(const std::string& name)
+{
+  std::string::size_type slash = name.rfind('/');
+  std::string dir = (slash == std::string::npos) ? "." : name.substr(0, slash + 1);
+  int fd = ::open(dir.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  ::fsync(fd);
+  ::close(fd);
+}
+
+RC WriteAheadLog::open(const std::string& name)
+{
+  LogState& s = state();
+  long long pages;
+  RC rc;
+
+  if (isOpen()) return RC_FILE_OPEN_FAILED;
+
+  // a log left by a crash is replayed first
+  if ((rc = recover(name, pages)) < 0) return rc;
+
+  std::unique_lock<std::mutex> lock(s.latch);
+  if (s.fd >= 0) return RC_FILE_OPEN_FAILED;
+  if ((s.fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+    s.fd = -1;
+    return RC_FILE_OPEN_FAILED;
+  }
+  syncDirectory(name);
+
+  s.name = name;
+  s.buffer.clear();
+  s.buffer.reserve(BUFFER_SIZE + MAX_RECORD);
+  s.bufferStart = s.base = s.durable = 0;
+  s.failed = false;
+  s.files.clear();
+  s.changes.clear();
+  s.stats = IOStats::forFile(name);
+  return 0;
+}
+
+RC WriteAheadLog::close()
+{
+  LogState& s = state();
+  RC rc;
+  std::unique_lock<std::mutex> lock(s.latch);
+
+  if (s.fd < 0) return 0;
+  if (s.openFiles > 0) return RC_FILE_CLOSE_FAILED;
+
+  // a log that cannot be emptied is left for recover()
+  if ((rc = truncateLog(s, lock)) < 0) return rc;
+  ::close(s.fd);
+  s.fd = -1;
+  ::unlink(s.name.c_str());
+  return 0;
+}
+
+bool WriteAheadLog::isOpen()
+{
+  LogState& s = state();
+  std::unique_lock<std::mutex> lock(s.latch);
+  return s.fd >= 0;
+}
+
+RC WriteAheadLog::recover(const std::string& name, long long& pages)
+{
+  std::vector<char> record;
+  std::vector<off_t> undos;
+  LogHeader header;
+  off_t offset = 0, committed = 0;
+  long long last = -1;
+  RC rc;
+
+  pages = 0;
+  int fd = ::open(name.c_str(), O_RDONLY);
+  if (fd < 0) return (errno == ENOENT) ? 0 : RC_FILE_OPEN_FAILED;
+
+  // find the records up to the first one that is torn or corrupt, and the
+  // end of the last commit among them
+  while (readRecord(fd, offset, last, header, record)) {
+    if (header.type == UNDO_RECORD) undos.push_back(offset);
+    offset += record.size();
+    last = header.lsn;
+    if (header.type == COMMIT_RECORD) committed = offset;
+  }
+
+  // the pages changed after the last commit go back to their old content,
+  // and then the pages logged before it are written again
+  if ((rc = undo(fd, committed, undos, pages)) == 0) rc = redo(fd, committed, pages);
+  ::close(fd);
+
+  if (rc == 0 && ::unlink(name.c_str()) < 0) rc = RC_FILE_WRITE_FAILED;
+  return rc;
+}
+
+RC WriteAheadLog::logPage(const std::string& file, PageId pid, int pageSize, int flags,
+                          const char* data, int size, long long& lsn)
+{
+  LogState& s = state();
+  PageRecord page;
+  std::unique_lock<std::mutex> lock(s.latch);
+
+  if (s.fd < 0 || s.failed) return RC_FILE_WRITE_FAILED;
+
+  page.pid = pid;
+  page.pageSize = pageSize;
+  page.flags = flags & PageFile::CHECKSUM;
+  page.nameLength = (int32_t)file.size();
+  page.dataSize = size;
+  struct iovec parts[3] = {
+    { &page, sizeof(page) },
+    { (void*)file.data(), file.size() },
+    { (void*)data, (size_t)size }
+  };
+  lsn = append(s, PAGE_RECORD, parts, 3);
+  s.files.insert(file);
+  s.changes[file].pages.insert(std::make_pair(pid, false));
+
+  return spill(s);
+}
+
+bool WriteAheadLog::needsUndo(const std::string& file, PageId pid, off_t offset)
+{
+  LogState& s = state();
+  std::unique_lock<std::mutex> lock(s.latch);
+
+  // a page is undone once per commit, and a page past the point where the
+  // file is truncated needs nothing more
+  std::map<std::string, Changes>::iterator c = s.changes.find(file);
+  if (c == s.changes.end() || (c->second.end >= 0 && offset >= c->second.end)) return false;
+  std::map<PageId, bool>::iterator it = c->second.pages.find(pid);
+  return it != c->second.pages.end() && !it->second;
+}
+
+RC WriteAheadLog::logUndo(const std::string& file, PageId pid, off_t offset,
+                          const char* data, int size, long long& lsn)
+{
+  LogState& s = state();
+  UndoRecord undo;
+  std::unique_lock<std::mutex> lock(s.latch);
+
+  lsn = 0;
+  if (s.fd < 0 || s.failed) return RC_FILE_WRITE_FAILED;
+
+  Changes& c = s.changes[file];
+  c.pages[pid] = true;
+  if (c.end >= 0 && offset >= c.end) return 0;
+  if (size == 0) c.end = offset;
+
+  undo.pid = pid;
+  undo.offset = offset;
+  undo.nameLength = (int32_t)file.size();
+  undo.dataSize = size;
+  struct iovec parts[3] = {
+    { &undo, sizeof(undo) },
+    { (void*)file.data(), file.size() },
+    { (void*)data, (size_t)size }
+  };
+  lsn = append(s, UNDO_RECORD, parts, size > 0 ? 3 : 2);
+  s.files.insert(file);
+  return spill(s);
+}
+
+RC WriteAheadLog::flush(long long lsn)
+{
+  LogState& s = state();
+  std::vector<char> data;
+  std::unique_lock<std::mutex> lock(s.latch);
+
+  while (s.durable < lsn) {
+    if (s.fd < 0 || s.failed) return RC_FILE_WRITE_FAILED;
+
+    // a sync in progress may not cover the record; wait for it, and then
+    // sync everything that was appended meanwhile in one go
+    if (s.syncing) {
+      s.synced.wait(lock);
+      continue;
+    }
+    s.syncing = true;
+    data.clear();
+    data.swap(s.buffer);
+    long long start = s.bufferStart, end = start + data.size();
+    s.bufferStart = end;
+    s.buffer.reserve(BUFFER_SIZE + MAX_RECORD);
+
+    lock.unlock();
+    bool ok = (data.empty() || writeLog(s, data, start)) && ::fdatasync(s.fd) == 0;
+    lock.lock();
+
+    s.syncing = false;
+    if (ok) {
+      s.durable = end;
+      s.syncs++;
+    } else {
+      s.failed = true;
+    }
+    s.synced.notify_all();
+  }
+  return 0;
+}
+
+RC WriteAheadLog::commit()
+{
+  LogState& s = state();
+  long long lsn;
+  {
+    std::unique_lock<std::mutex> lock(s.latch);
+    if (s.fd < 0 || s.failed) return RC_FILE_WRITE_FAILED;
+    lsn = append(s, COMMIT_RECORD, NULL, 0);
+    s.changes.clear();
+    s.commits++;
+  }
+  return flush(lsn);
+}
+
+bool WriteAheadLog::opened()
+{
+  LogState& s = state();
+  std::unique_lock<std::mutex> lock(s.latch);
+
+  if (s.fd < 0) return false;
+  s.openFiles++;
+  return true;
+}
+
+void WriteAheadLog::closed()
+{
+  LogState& s = state();
+  std::unique_lock<std::mutex> lock(s.latch);
+
+  // the last logged file closed: a long log is emptied (or left for
+  // recover() if that fails)
+  if (--s.openFiles > 0 || s.fd < 0) return;
+  if (s.bufferStart + (long long)s.buffer.size() - s.base >= TRUNCATE_SIZE) truncateLog(s, lock);
+}
+
+long long WriteAheadLog::getCommitCount()
+{
+  LogState& s = state();
+  std::unique_lock<std::mutex> lock(s.latch);
+  return s.commits;
+}
+
+long long WriteAheadLog::getSyncCount()
+{
+  LogState& s = state();
+  std::unique_lock<std::mutex> lock(s.latch);
+  return s.syncs;
+}
@@ -0,0 +1,151 @@
+/*
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ *
+ * @date 10/17/2026
+ */
+
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <string>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * a sequential, append-only redo log of the pages written to the files
+ * opened with PageFile::LOGGED. every PageFile::write() of such a file
+ * appends the new content of the page to the log, and the buffer pool
+ * makes the log durable up to the last change of a dirty page before it
+ * writes the page to its file (the write-ahead rule). commit() makes
+ * everything logged so far durable; the commits that arrive while the
+ * log is being synced are served together by the next fdatasync (group
+ * commit), so a durable statement costs a sequential log write instead
+ * of syncing its pages.
+ * the pages changed since the last commit may be written to their files
+ * before the commit (the buffer pool evicts them). the first time such a
+ * page is written, its old content on the disk is logged as well, so
+ * that the write can be undone.
+ * the log is a series of records, each a LogHeader followed by the
+ * record (see WriteAheadLog.cc). recover() undoes the writes of the
+ * pages changed after the last commit that reached the disk, writes the
+ * pages logged before it to their files, and removes the log, which
+ * leaves the files as they were at that commit.
+ * once no logged file is open and the log has grown past TRUNCATE_SIZE,
+ * the logged files are synced and the log is emptied.
+ * all functions are thread-safe.
+ */
+class WriteAheadLog {
+ public:
+  static const char* const DEFAULT_NAME;          // the log of bruinbase
+  static const size_t BUFFER_SIZE = 1024 * 1024;  // records kept in memory
+  static const long long TRUNCATE_SIZE = 64LL * 1024 * 1024;
+
+  /**
+   * recover from the log if it exists, and start logging to it.
+   * @param name[IN] the name of the log
+   * @return error code. 0 if no error
+   */
+  static RC open(const std::string& name);
+
+  /**
+   * stop logging: sync the logged files and remove the log. this fails
+   * while a logged file is open.
+   * @return error code. 0 if no error
+   */
+  static RC close();
+
+  /**
+   * @return true if the log is open
+   */
+  static bool isOpen();
+
+  /**
+   * recover from a log left by a crash: undo the writes of the pages
+   * changed after the last complete commit record, write the pages
+   * logged before it to their files, sync the files, and remove the log.
+   * nothing is done if the log does not exist.
+   * @param name[IN] the name of the log
+   * @param pages[OUT] # pages written
+   * @return error code. 0 if no error
+   */
+  static RC recover(const std::string& name, long long& pages);
+
+  /**
+   * append the new content of a page to the log (in memory).
+   * @param file[IN] the name of the file of the page
+   * @param pid[IN] the page
+   * @param pageSize[IN] the page size of the file
+   * @param flags[IN] the options of the file (PageFile::CHECKSUM matters)
+   * @param data[IN] the content of the page
+   * @param size[IN] # bytes of the content
+   * @param lsn[OUT] the position of the record, to give to flush()
+   * @return error code. 0 if no error
+   */
+  static RC logPage(const std::string& file, PageId pid, int pageSize, int flags,
+                    const char* data, int size, long long& lsn);
+
+  /**
+   * called before a page of a logged file is written to the file.
+   * @param file[IN] the name of the file of the page
+   * @param pid[IN] the page
+   * @param offset[IN] the file offset of the page
+   * @return true if the page changed since the last commit and its old
+   *         content must be logged with logUndo() before it is written
+   */
+  static bool needsUndo(const std::string& file, PageId pid, off_t offset);
+
+  /**
+   * append the content of a page on the disk to the log (in memory), so
+   * that recover() can undo a write of the page after the last commit.
+   * @param file[IN] the name of the file of the page
+   * @param pid[IN] the page
+   * @param offset[IN] the file offset of the page, or the length of the
+   *                   file if the page is past its end
+   * @param data[IN] the content of the page on the disk
+   * @param size[IN] # bytes of the content. 0 if the page is past the end
+   *                 of the file, which recover() cuts back to offset
+   * @param lsn[OUT] the position of the record, to give to flush().
+   *                 0 if no record was needed
+   * @return error code. 0 if no error
+   */
+  static RC logUndo(const std::string& file, PageId pid, off_t offset,
+                    const char* data, int size, long long& lsn);
+
+  /**
+   * make the log durable at least up to a record.
+   * @param lsn[IN] the position of the record (see logPage())
+   * @return error code. 0 if no error
+   */
+  static RC flush(long long lsn);
+
+  /**
+   * make everything logged so far durable.
+   * @return error code. 0 if no error
+   */
+  static RC commit();
+
+  /**
+   * called by PageFile when a file opened with PageFile::LOGGED is opened.
+   * @return true if the file is logged, false if the log is not open
+   */
+  static bool opened();
+
+  /**
+   * called by PageFile when a logged file is closed. the log may be
+   * emptied if it was the last one (see TRUNCATE_SIZE).
+   */
+  static void closed();
+
+  /**
+   * @return the total # of commit() calls
+   */
+  static long long getCommitCount();
+
+  /**
+   * @return the total # of fdatasync of the log
+   */
+  static long long getSyncCount();
+};
+
+#endif // WRITEAHEADLOG_H
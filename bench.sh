@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# time the test.sql workload (see test.sh) without and with some settings.
+# usage: sh bench.sh "<SET commands, separated by ;>" [runs] [bruinbase options]
+# e.g.,  sh bench.sh "SET page_checksums 1" 5 -p 64
+# set WORKLOAD to time another file of commands; the tables it LOADs are
+# dropped before every run.
+# e.g.,  WORKLOAD=lookups.sql sh bench.sh "SET huge_pages 1" 5 -p 65536
+#
+
+settings=$1
+runs=${2:-5}
+workload=${WORKLOAD:-test.sql}
+tables=$(sed -n 's/^ *load  *\([A-Za-z0-9_]*\) .*/\1/Ip' "$workload")
+[ $# -gt 2 ] && shift 2 || set --
+
+run() {
+  commands=$1
+  shift
+  total=0
+  pages=0
+  i=0
+  while [ $i -lt $runs ]; do
+    for t in $tables; do rm -f $t.tbl $t.idx; done
+    start=$(date +%s%N)
+    { echo "$commands" | tr ';' '\n'; cat "$workload"; } | ./bruinbase "$@" > /dev/null 2> bench.err
+    end=$(date +%s%N)
+    total=$((total + (end - start) / 1000))
+    pages=$((pages + $(sed -n 's/.*Read \([0-9]*\) pages.*/\1/p' bench.err | awk '{s += $1} END {print s + 0}')))
+    i=$((i + 1))
+  done
+  echo "$((total / runs)) usec per run, $((pages / runs)) pages read by SELECTs"
+}
+
+echo "baseline:   $(run "" "$@")"
+echo "$settings: $(run "$settings" "$@")"
+rm -f bench.err
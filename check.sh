@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# regression checks: the results of test.sql (see test.sh) must not
+# change with the settings of the buffer pool, the page files and the
+# indexes, and a LOAD killed under write_ahead_log must not lose the
+# LOADs committed before it.
+# usage: sh check.sh (after make; the .del files are taken from
+# project2-test.zip if they are not in the current directory)
+#
+
+tables="xsmall small medium large xlarge crash"
+failures=0
+
+[ -f xlarge.del ] || unzip -o -q project2-test.zip '*.del' || exit 1
+
+clean() {
+  for t in $tables; do rm -f $t.tbl $t.idx $t.tbl.warm $t.idx.warm; done
+  rm -f bruinbase.wal
+}
+
+# run test.sql after some SET commands (separated by ;), and compare the
+# results with test.expected
+check() {
+  clean
+  { echo "$1" | tr ';' '\n'; cat test.sql; } | ./bruinbase 2> check.err | sed 's/Bruinbase> //g' > check.out
+  if cmp -s check.out test.expected && ! grep -q Error check.err; then
+    echo "ok: $1"
+  else
+    echo "FAILED: $1"
+    failures=$((failures + 1))
+  fi
+}
+
+check "SET buffer_pool_pages 16"
+check "SET replacement_policy '2q'"
+check "SET page_size 8192"
+check "SET page_checksums 1"
+check "SET shadow_indexes 1"
+check "SET write_ahead_log 1"
+check "SET buffer_pool_pages 16;SET replacement_policy '2q';SET page_size 8192;SET page_checksums 1;SET shadow_indexes 1"
+
+# kill bruinbase in the middle of a long LOAD (once it has logged a few
+# MB), after a LOAD that was committed. the pool is small, so that pages
+# of the killed LOAD reach the files. the log is replayed when it is
+# opened again: the committed LOAD is complete, and nothing is left of
+# the killed one.
+clean
+awk 'BEGIN { for (i = 1; i <= 200000; i++) printf "%d,\"movie %d\"\n", i, i }' > crash.del
+printf "SET buffer_pool_pages 64\nSET write_ahead_log 1\nLOAD small FROM 'small.del' WITH INDEX\nLOAD crash FROM 'crash.del' WITH INDEX\n" > crash.sql
+./bruinbase < crash.sql > /dev/null 2>&1 &
+pid=$!
+while { [ ! -f bruinbase.wal ] || [ $(wc -c < bruinbase.wal) -lt 4000000 ]; } && kill -0 $pid 2> /dev/null; do
+  sleep 0.05
+done
+kill -9 $pid 2> /dev/null
+wait
+printf "SET write_ahead_log 1\nSELECT COUNT(*) FROM small\nSELECT * FROM small WHERE key > 100 AND key < 500\nSELECT COUNT(*) FROM crash\n" |
+  ./bruinbase 2> check.err | sed 's/Bruinbase> //g' > check.out
+{ sed -n '/^50$/,/^489 /p' test.expected; echo 0; } > crash.expected
+if cmp -s check.out crash.expected && ! grep -q Error check.err && [ ! -f bruinbase.wal ]; then
+  echo "ok: recovery of a killed LOAD"
+else
+  echo "FAILED: recovery of a killed LOAD"
+  failures=$((failures + 1))
+fi
+rm -f crash.del crash.sql crash.expected check.out check.err
+
+clean
+[ $failures -eq 0 ] || exit 1
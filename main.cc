@@ -7,13 +7,64 @@
  * @date 3/24/2008
  */
  
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
 #include "Bruinbase.h"
 #include "SqlEngine.h"
+#include "BufferPool.h"
+#include "PageFile.h"
+#include "WriteAheadLog.h"
 
-int main()
+static void usage(const char* prog)
 {
+  fprintf(stderr, "usage: %s [-p buffer_pool_pages] [-H] [-w warmup_pages]\n", prog);
+}
+
+int main(int argc, char* argv[])
+{
+  int c;
+  long long pages;
+
+  // startup options
+  while ((c = getopt(argc, argv, "p:Hw:")) != -1) {
+    switch (c) {
+    case 'p':
+      if (BufferPool::setPoolSize(atoi(optarg)) < 0) {
+        fprintf(stderr, "Error: buffer_pool_pages must be at least %d\n", BufferPool::MIN_FRAME_COUNT);
+        return 1;
+      }
+      break;
+    case 'H':
+      // back the buffer pool with huge pages
+      BufferPool::setHugePages(true);
+      break;
+    case 'w':
+      // prefetch the pages that were hot in the previous run
+      PageFile::setWarmup(atoi(optarg));
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // bring the files up to date with the log left by a crash, if any
+  if (WriteAheadLog::recover(WriteAheadLog::DEFAULT_NAME, pages) < 0) {
+    fprintf(stderr, "Error: could not recover from %s\n", WriteAheadLog::DEFAULT_NAME);
+    return 1;
+  }
+  if (pages > 0) fprintf(stderr, "Recovered %lld pages from %s\n", pages, WriteAheadLog::DEFAULT_NAME);
+
   // run the SQL engine taking user commands from standard input (console).
   SqlEngine::run(stdin);
+
+  // shut down: a clean exit leaves no log to recover from, and the hot
+  // pages of the files for the next run
+  if (WriteAheadLog::close() < 0) {
+    fprintf(stderr, "Error: could not close the log %s\n", WriteAheadLog::DEFAULT_NAME);
+  }
+  PageFile::saveWarmupLists();
    
   return 0;
 }
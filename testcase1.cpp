@@ -11,6 +11,7 @@
 #include "BTreeIndex.h"
 #include "BTreeNode.h"
 #include "PageFile.h"
+#include "RecordFile.h"
 using namespace std;
 int main()
 {
@@ -50,7 +51,7 @@ int main()
   
         node->insert(i,b);
         //index->insert(i,b);
-        b++;
+        rf.advance(b);
     }
     /*
     BTLeafNode* sibling = new BTLeafNode();
@@ -87,7 +88,7 @@ int main()
     
     node->locate(1, eid);
     cout << "eid: " << eid <<endl;
-    int eid2;
+    PageId eid2;
     sibling ->locate(15, eid2);
     cout << "eid2 " << eid2 <<endl;
     */
@@ -105,6 +106,7 @@ int main()
     b.pid = a;
     b.sid = 5;
     PageFile pf;
+    RecordFile rf("BTindex32.tbl", 'w');
     index->open("BTindex32.txt", 'w');
     
     
@@ -112,7 +114,7 @@ int main()
         
         index->insert(i,b);
         cout << " rootPid2 "<<index->getrootpid()<<endl;
-        b++;
+        rf.advance(b);
     }
     IndexCursor cursor;
     RC what;
@@ -203,12 +205,12 @@ int main()
     node->printNodeContent();
     cout<<endl;
     sibling->printNodeContent();
-    int eid;
+    PageId eid;
     
     
     node->locateChildPtr(3, eid);
     cout << "eid: " << eid <<endl;
-    int eid2;
+    PageId eid2;
     sibling ->locateChildPtr(12, eid2);
     cout << "eid2 " << eid2 <<endl;
     */
@@ -222,7 +224,7 @@ int main()
     bb.sid = 0;
     for(int i = 0; i < 10; i++){
         node->insert(aa,bb);
-        bb++;
+        rf.advance(bb);
         aa++;
     }
     */
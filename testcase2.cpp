@@ -18,6 +18,7 @@ BTNonLeafNode* node = new BTNonLeafNode();
 PageId a = 1;
 PageFile pf;
 pf.open("pagefilefornonleaf.txt",'w');
+node->create(0, pf);
 int siblingkey;
 for(int i = 0; i < 14; i+=3){
     
@@ -26,6 +27,7 @@ for(int i = 0; i < 14; i+=3){
     a++;
 }
 BTNonLeafNode* sibling = new BTNonLeafNode();
+sibling->create(1, pf);
 node->insertAndSplit(20, a, *sibling, siblingkey);
 node->write(0,pf);
 sibling->write(1,pf);
@@ -39,12 +41,12 @@ RecordId rid;
 node->printNodeContent();
 cout<<endl;
 sibling->printNodeContent();
-int eid;
+PageId eid;
 
 
 node->locateChildPtr(1, eid);
 cout << "eid: " << eid <<endl;
-int eid2;
+PageId eid2;
 sibling ->locateChildPtr(0, eid2);
 cout << "eid2 " << eid2 <<endl;
 }
\ No newline at end of file
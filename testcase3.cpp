@@ -0,0 +1,101 @@
+//
+//  testcase3.cpp
+//
+//  2Q scan resistance: a table scan pins each page once per tuple, and
+//  must not push a set of pages that are used again and again (e.g.,
+//  index nodes) out of the buffer pool.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "BufferPool.h"
+#include "PageFile.h"
+
+static const char* FILE_NAME = "testcase3.pf";
+static const int POOL_PAGES = 64;
+static const int HOT_PAGES = 24;      // more than the A1in share (1/4)
+static const int HOT_ROUNDS = 3;
+static const int FILE_PAGES = 400;    // the scan reads all other pages
+static const int PINS_PER_PAGE = 10;  // one per tuple
+
+static bool touch(PageFile& pf, PageId pid)
+{
+  char* page;
+  if (pf.pin(pid, page) < 0) return false;
+  pf.unpin(pid);
+  return true;
+}
+
+static int run(const char* policy)
+{
+  PageFile pf;
+  PageId pid;
+  int round, i, cached = 0;
+
+  BufferPool::setPolicy(policy);
+  if (pf.open(FILE_NAME, 'r') < 0) return -1;
+
+  // the hot set: each page used a few times, with other pages in between
+  for (round = 0; round < HOT_ROUNDS; round++) {
+    for (pid = 0; pid < HOT_PAGES; pid++) {
+      if (!touch(pf, pid)) return -1;
+    }
+  }
+
+  // a full scan of the file, a few tuples per page
+  for (pid = HOT_PAGES; pid < FILE_PAGES; pid++) {
+    for (i = 0; i < PINS_PER_PAGE; i++) {
+      if (!touch(pf, pid)) return -1;
+    }
+  }
+
+  // the hot pages still cached (BufferPool::pin() does not read pages)
+  BufferPool& pool = BufferPool::getPool(pf.getPageSize());
+  for (pid = 0; pid < HOT_PAGES; pid++) {
+    if (pool.pin(&pf, pid) != NULL) {
+      pool.unpin(&pf, pid);
+      cached++;
+    }
+  }
+
+  pf.close();
+  return cached;
+}
+
+int main()
+{
+  PageFile pf;
+  char buffer[PageFile::PAGE_SIZE];
+  PageId pid;
+  int lru, twoq;
+
+  BufferPool::setPoolSize(POOL_PAGES);
+  PageFile::setReadahead(0);
+
+  unlink(FILE_NAME);
+  if (pf.open(FILE_NAME, 'w') < 0) {
+    fprintf(stderr, "could not create %s\n", FILE_NAME);
+    return 1;
+  }
+  for (pid = 0; pid < FILE_PAGES; pid++) {
+    memset(buffer, pid & 0xff, sizeof(buffer));
+    if (pf.write(pid, buffer) < 0) {
+      fprintf(stderr, "could not write page %lld\n", (long long)pid);
+      return 1;
+    }
+  }
+  pf.close();
+
+  lru = run("lru");
+  twoq = run("2q");
+  unlink(FILE_NAME);
+
+  printf("hot pages cached after the scan: lru %d, 2q %d of %d\n", lru, twoq, HOT_PAGES);
+  if (twoq != HOT_PAGES) {
+    printf("FAILED: 2q let the scan evict the hot set\n");
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,82 @@
+//
+//  testcase4.cpp
+//
+//  free page reuse: the pages freed in one session are handed out again
+//  after the file is reopened, and a damaged free list is discarded
+//  instead of handing out pages that are in use.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "PageFile.h"
+
+static const char* FILE_NAME = "testcase4.pf";
+static const int FILE_PAGES = 20;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+  printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+  if (!ok) failures++;
+}
+
+// create the file with pages 5, 6 and 7 free. the list is stored in the
+// last free page (7) as [next][count][5][6].
+static bool create()
+{
+  PageFile pf;
+  char buffer[PageFile::PAGE_SIZE];
+
+  unlink(FILE_NAME);
+  if (pf.open(FILE_NAME, 'w') < 0) return false;
+  memset(buffer, 0, sizeof(buffer));
+  for (PageId pid = 0; pid < FILE_PAGES; pid++) {
+    if (pf.write(pid, buffer) < 0) return false;
+  }
+  for (PageId pid = 5; pid <= 7; pid++) {
+    if (pf.freePage(pid) < 0) return false;
+  }
+  return pf.close() == 0;
+}
+
+// overwrite field i of the list page (a new file has a header page, and
+// stores page ids in 8 bytes)
+static bool damage(int i, PageId value)
+{
+  int fd = open(FILE_NAME, O_WRONLY);
+  off_t offset = PageFile::PAGE_SIZE + 7 * PageFile::PAGE_SIZE + i * sizeof(PageId);
+  bool ok = (fd >= 0 && pwrite(fd, &value, sizeof(value), offset) == sizeof(value));
+  if (fd >= 0) close(fd);
+  return ok;
+}
+
+static PageId allocate()
+{
+  PageFile pf;
+  PageId pid = -1;
+
+  if (pf.open(FILE_NAME, 'w') < 0 || pf.allocatePage(pid) < 0) return -1;
+  pf.close();
+  return pid;
+}
+
+int main()
+{
+  check(create() && allocate() == 5, "a freed page is reused after reopening");
+  check(allocate() == 6, "the rest of the list survives a reuse");
+
+  check(create() && damage(2, 3) && allocate() == FILE_PAGES,
+        "a list that names a page in use is discarded");
+  check(create() && damage(0, 7) && allocate() == FILE_PAGES,
+        "a list that loops is discarded");
+  check(create() && damage(1, 3) && allocate() == FILE_PAGES,
+        "a list with a wrong count is discarded");
+
+  unlink(FILE_NAME);
+  if (failures > 0) return 1;
+  printf("OK\n");
+  return 0;
+}